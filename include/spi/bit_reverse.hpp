@@ -0,0 +1,60 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_BIT_REVERSE_HPP
+#define IPASS_SPI_BIT_REVERSE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /// \brief Lookup table containing the bit-reversed value of every byte
+    extern const uint8_t bit_reverse_table[256];
+
+    /**
+     * \brief Reverse the bit order of a single byte
+     * @param b Byte to reverse
+     * @return b with bit 0 and 7, 1 and 6 etc. swapped
+     */
+    inline uint8_t reverse_bits(uint8_t b) {
+        return bit_reverse_table[b];
+    }
+
+    /**
+     * \brief Reverse the bit order of every byte in a buffer, keeping the byte order
+     *
+     * Works a word at a time, out may be the same as in.
+     * @param n Size of the buffer
+     * @param in Buffer to reverse
+     * @param out Buffer to write the reversed bytes into
+     */
+    void reverse_bits(size_t n, const uint8_t *in, uint8_t *out);
+
+    /**
+     * \brief Reverse the bit order of a whole buffer (both bits and bytes are reversed)
+     *
+     * Used to turn an LSByte and LSBit first transfer into a plain MSB first one.
+     * Works a word at a time, out may NOT overlap in.
+     * @param n Size of the buffer
+     * @param in Buffer to reverse
+     * @param out Buffer to write the reversed bytes into
+     */
+    void reverse_bits_and_bytes(size_t n, const uint8_t *in, uint8_t *out);
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_BIT_REVERSE_HPP
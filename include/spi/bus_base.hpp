@@ -11,6 +11,8 @@
 #define OOPC_OPDRACHTEN_SPI_BASE_HPP
 
 #include <hwlib.hpp>
+#include <spi/chip_select.hpp>
+#include <spi/crc.hpp>
 
 namespace spi {
 
@@ -18,7 +20,7 @@ namespace spi {
      * \defgroup spi_ex SPI bus Extended Library
      * \brief Library for SPI implementations
      *
-     * Includes support for reverse reading and writing (LSByte first), and setting SPI operating modes.
+     * Includes support for reverse reading and writing (LSByte first), LSBit first transfers, CRC generation/checking, and setting SPI operating modes.
      */
 
     /**
@@ -38,12 +40,14 @@ namespace spi {
         bool clock_phase = false;
         /// \brief Duration of half a cycle in nanoseconds
         uint32_t half_time_ns = 1000;
+        /// \brief Bit order, shift out the least significant bit of every byte first when true
+        bool lsb_first = false;
 
-        /// \brief Empty constructor, assumes polarity 0, phase 0, and half_time 1000
+        /// \brief Empty constructor, assumes polarity 0, phase 0, half_time 1000 and MSB first
         spi_mode();
 
         /// \brief Create a new spi_mode
-        spi_mode(bool clockPolarity, bool clockPhase, uint32_t halfTimeNs);
+        spi_mode(bool clockPolarity, bool clockPhase, uint32_t halfTimeNs, bool lsbFirst = false);
     };
 
     /**
@@ -52,6 +56,7 @@ namespace spi {
      * Supports byte-reversed transactions.
      * Automatically handles transaction start and end.
      * When overriding, the choice can be made to implement de reverse functions. When this is not done, they rely on the base read and write implementations, and use a buffer to reverse these.
+     * Implementations that can't shift LSBit first themselves get their data bit-reversed by the base class when the mode asks for it.
      */
     class spi_base_bus {
     protected:
@@ -81,6 +86,50 @@ namespace spi {
          */
         virtual void write_read_reverse(size_t n, const uint8_t *data_out, uint8_t *data_in);
 
+        /**
+         * \brief Whether this implementation handles mode.lsb_first itself
+         *
+         * When this returns false, and the mode is LSBit first, the base class reverses the bits of every byte before and after transferring
+         * @return True if the bus can shift LSBit first natively
+         */
+        virtual bool native_lsb_first() const;
+
+        /**
+         * \brief Transfer data, applying the bit order of this bus
+         *
+         * Used by spi_transaction for all transfers.
+         * @param n Size of the data to transfer
+         * @param data_out Memory pointer to the data to write
+         * @param data_in Memory pointer to a location to read data into
+         * @param reverse Whether to transfer LSByte first
+         */
+        void transfer(size_t n, const uint8_t *data_out, uint8_t *data_in, bool reverse);
+
+        /**
+         * \brief Transfer data followed by its CRC
+         *
+         * Transfers n bytes, adding either the outgoing or incoming bytes to the CRC, and then transfers the CRC itself.
+         * When writing, the calculated CRC is sent. When checking, the CRC is read and compared to the calculated one.
+         * When this method is not overridden, the CRC is calculated over the buffer after transferring it.
+         * Implementations should override this to calculate it while transferring.
+         * @param n Size of the data to transfer (excluding CRC)
+         * @param data_out Memory pointer to the data to write
+         * @param data_in Memory pointer to a location to read data into
+         * @param crc CRC to update, it is not reset first
+         * @param check True to calculate over the incoming data and check the received CRC, false to calculate over the outgoing data and send the CRC
+         * @return False if checking, and the received CRC didn't match, true otherwise
+         */
+        virtual bool write_read_crc(size_t n, const uint8_t *data_out, uint8_t *data_in, crc_base &crc, bool check);
+
+        /**
+         * \brief Make sure every read so far has filled its buffer
+         *
+         * Implementations may postpone reads until the transaction ends, to send a whole transaction at once.
+         * The base class calls this before using data it read into a buffer of its own.
+         * When this method is not overridden, it does nothing, reads are then expected to complete immediately.
+         */
+        virtual void complete_reads();
+
     public:
         /**
          * \brief Transaction handler for SPI
@@ -94,6 +143,8 @@ namespace spi {
         public:
             /// \brief Chip select pin for this transaction.
             hwlib::pin_out &csn;
+            /// \brief Register-based chip select for this transaction, nullptr when csn is used
+            const chip_select *fast_csn = nullptr;
 
             /**
              * \brief Create a transaction from a bus and CSN pin.
@@ -102,6 +153,13 @@ namespace spi {
              */
             explicit spi_transaction(spi_base_bus &bus, hwlib::pin_out &csn);
 
+            /**
+             * \brief Create a transaction from a bus and a register-based chip select.
+             *
+             * Prefer to use bus.transaction(), since implementations can override this
+             */
+            explicit spi_transaction(spi_base_bus &bus, const chip_select &csn);
+
             /**
              * \brief Transaction destructor, used to call bus.onEnd().
              */
@@ -173,6 +231,37 @@ namespace spi {
              * @return This transaction, for method chaining
              */
             spi_transaction &write_byte(const uint8_t &byte, uint8_t *data_in = nullptr);
+
+            /**
+             * \brief Write n bytes through the bus, followed by their CRC
+             *
+             * The CRC is calculated while writing, and continues from its current value (call crc.reset() to start over).
+             * @param n Number of bytes to transfer (excluding CRC)
+             * @param data_out Pointer to the data to write
+             * @param crc CRC to calculate
+             * @return This transaction, for method chaining
+             */
+            spi_transaction &write_crc(size_t n, const uint8_t *data_out, crc_base &crc);
+
+            /**
+             * \brief Read n bytes through the bus, followed by a CRC, and check it
+             *
+             * The CRC is calculated while reading, and continues from its current value (call crc.reset() to start over).
+             * Note that the needed return value of this function prevents any further method chaining.
+             * @param n Number of bytes to transfer (excluding CRC)
+             * @param data_in Pointer to the memory location to read into
+             * @param crc CRC to calculate
+             * @return True if the received CRC matched the data
+             */
+            bool read_crc(size_t n, uint8_t *data_in, crc_base &crc);
+
+            /**
+             * \brief Make sure all data read so far is in its buffer
+             *
+             * Only needed when data read in a transaction is used before the transaction ends, on a bus that postpones reads (like bus_spidev).
+             * @return This transaction, for method chaining
+             */
+            spi_transaction &complete();
         };
 
     protected:
@@ -204,6 +293,15 @@ namespace spi {
          */
         spi_transaction transaction(hwlib::pin_out &csn);
 
+        /**
+         * \brief Start a transaction using a register-based chip select
+         *
+         * Selecting and deselecting take a single register store, instead of a virtual pin_out call.
+         * @param csn Chip select
+         * @return The transaction created
+         */
+        spi_transaction transaction(const chip_select &csn);
+
         /**
          * \brief Create a bus, using a spi mode
          * @param mode Mode to use
@@ -22,6 +22,10 @@ namespace spi {
      * \brief BitBanged SPI implementation
      *
      * Has full support for operating modes.
+     * The time spent on pin operations is measured at construction, and subtracted from every half period,
+     * so the achieved clock rate matches mode.half_time_ns as close as possible.
+     * When mode.half_time_ns is 0, waiting is skipped entirely, and the bus runs as fast as the pins allow.
+     * Both MSBit and LSBit first bit orders are shifted natively.
      */
     class bus_bitbang : public spi_base_bus {
     protected:
@@ -31,6 +35,12 @@ namespace spi {
         hwlib::pin_direct_from_out_t mosi;
         /// \brief Master In Slave Out pin
         hwlib::pin_direct_from_in_t miso;
+        /// \brief Time actually waited every half period, mode.half_time_ns minus the measured pin overhead
+        uint32_t half_wait_ns = 0;
+        /// \brief Amount of clock cycles used to measure the pin overhead
+        static constexpr uint32_t calibration_cycles = 256;
+        /// \brief Set by subclasses overriding delay_ns(), otherwise waiting calls hwlib directly, without a virtual call
+        bool delay_hooked = false;
     public:
         /**
          * \brief Create a bitbang-bus using pins and a spi mode
@@ -42,12 +52,44 @@ namespace spi {
         bus_bitbang(hwlib::pin_out &_sclk, hwlib::pin_out &_mosi, hwlib::pin_in &_miso,
                     const spi::spi_mode &mode);
 
+        /**
+         * \brief Measure the time spent on pin operations, and recalculate the wait time per half period
+         *
+         * Writes the idle level to SCLK and a low level to MOSI, without clocking any bits, so this should only be called outside of transactions.
+         * Called automatically on construction.
+         */
+        void calibrate();
+
+        /**
+         * \brief Get the time actually waited every half period
+         * @return Wait time in nanoseconds
+         */
+        uint32_t get_half_wait_ns() const;
+
     protected:
         /**
          * \brief Wait for half a clock period, to let the lines settle
          */
         void wait_half_period();
 
+        /**
+         * \brief Busy-wait for a number of nanoseconds
+         *
+         * All timing of this bus goes through this method when delay_hooked is set.
+         * Can be overridden to substitute a different time source, for example a virtual clock when simulating the bus.
+         * Subclasses overriding this should set delay_hooked.
+         * @param ns Amount of nanoseconds to wait
+         */
+        virtual void delay_ns(uint32_t ns);
+
+        /**
+         * \brief Get the current time, used for calibration
+         *
+         * Should be overridden together with delay_ns()
+         * @return Current time in nanoseconds
+         */
+        virtual uint_fast64_t now_ns();
+
         /**
          * \brief Writes + Reads a single byte
          *
@@ -55,6 +97,32 @@ namespace spi {
          */
         void write_read_byte(uint8_t &d);
 
+    private:
+        /**
+         * \brief Writes + Reads a single byte, optionally without waiting
+         * @tparam wait Whether to wait half a period between edges
+         * @tparam lsb_first Whether to shift the least significant bit first
+         * @tparam hooked Whether to wait through delay_ns() instead of hwlib
+         * @param d Byte to write, the read byte is written into this aswell
+         */
+        template<bool wait, bool lsb_first, bool hooked>
+        void write_read_byte_timed(uint8_t &d);
+
+        /**
+         * \brief Wait for half a clock period, resolving the delay_ns() override at compile time
+         * @tparam hooked Whether to wait through delay_ns() instead of hwlib
+         */
+        template<bool hooked>
+        void wait_half_period_timed() {
+            if (hooked) {
+                delay_ns(half_wait_ns);
+            } else {
+                hwlib::wait_ns_busy(half_wait_ns);
+            }
+        }
+
+    protected:
+
         /**
          * \brief Writes + reads multiple bytes
          * @param n Amount of bytes
@@ -71,6 +139,19 @@ namespace spi {
          */
         void write_read_reverse(size_t n, const uint8_t *data_out, uint8_t *data_in) override;
 
+        /**
+         * \brief Writes + reads multiple bytes followed by their CRC, calculating the CRC while shifting
+         *
+         * \copydetails spi_base_bus::write_read_crc
+         */
+        bool write_read_crc(size_t n, const uint8_t *data_out, uint8_t *data_in, crc_base &crc, bool check) override;
+
+        /**
+         * \brief Bitbanging can shift in either direction, so bit order is handled natively
+         * @return true
+         */
+        bool native_lsb_first() const override;
+
     };
 
     /**
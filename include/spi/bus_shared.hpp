@@ -0,0 +1,223 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_SHARED_HPP
+#define IPASS_SPI_SHARED_HPP
+
+#include <spi/bus_base.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief Link in the submission queue of bus_shared
+     */
+    struct bus_job_node {
+        /// \brief Next node in the queue
+        std::atomic<bus_job_node *> next{nullptr};
+    };
+
+    /**
+     * \brief Work to be executed on a bus_shared
+     *
+     * Jobs are owned by the submitter, and should stay alive until they are done.
+     * A job can be resubmitted once it is done.
+     */
+    class bus_job : private bus_job_node {
+        friend class bus_shared;
+
+        /// \brief Set by the worker once the transaction containing this job has ended
+        std::atomic<bool> done{true};
+        /// \brief Shared bus this job was last submitted to
+        class bus_shared *owner = nullptr;
+        /// \brief Chip select pin to execute this job with, nullptr when fast_csn is used
+        hwlib::pin_out *csn = nullptr;
+        /// \brief Register-based chip select to execute this job with, nullptr when csn is used
+        const chip_select *fast_csn = nullptr;
+        /// \brief Whether this job may share a transaction with the job before it
+        bool merge = false;
+
+    protected:
+        /**
+         * \brief Perform the transfers of this job
+         *
+         * Called from the worker thread.
+         * @param transaction Transaction to transfer through
+         */
+        virtual void execute(spi_base_bus::spi_transaction &transaction) = 0;
+
+    public:
+        /**
+         * \brief Check whether the job is done, without blocking
+         * @return True once the transaction containing this job has ended
+         */
+        bool is_done() const;
+
+        /**
+         * \brief Block until the job is done
+         *
+         * The calling thread sleeps until the worker signals the job is done.
+         */
+        void wait() const;
+    };
+
+    /**
+     * \brief Job doing a single write_read
+     */
+    class transfer_job : public bus_job {
+        /// \brief Amount of bytes to transfer
+        size_t n;
+        /// \brief Data to write
+        const uint8_t *data_out;
+        /// \brief Memory location to read into
+        uint8_t *data_in;
+
+    protected:
+        void execute(spi_base_bus::spi_transaction &transaction) override;
+
+    public:
+        /**
+         * \brief Create a transfer job
+         * @param n Amount of bytes to transfer
+         * @param data_out Data to write, nullptr to write zeroes
+         * @param data_in Memory location to read into, nullptr to ignore input
+         */
+        transfer_job(size_t n, const uint8_t *data_out, uint8_t *data_in);
+    };
+
+    /**
+     * \brief Thread-safe front-end for a bus shared by multiple threads
+     *
+     * Producers submit jobs through a lock-free multi-producer single-consumer queue.
+     * A single worker thread owns the bus, and executes the jobs in submission order.
+     * Adjacent jobs that allow merging, and use the same chip select, are executed in a single transaction.
+     * Locks are only used to put the worker or waiting submitters to sleep, they are never held during a transfer.
+     */
+    class bus_shared {
+        /// \brief Maximum amount of jobs executed in a single transaction
+        static constexpr size_t max_batch = 16;
+
+        /// \brief The bus owned by the worker
+        spi_base_bus &bus;
+
+        /// \brief Placeholder node, keeps the queue from ever being empty
+        bus_job_node stub;
+        /// \brief Last submitted node, swapped by producers
+        std::atomic<bus_job_node *> head;
+        /// \brief Oldest node, only used by the worker
+        bus_job_node *tail;
+
+        /// \brief Amount of submitted jobs the worker hasn't picked up yet
+        std::atomic<size_t> pending{0};
+        /// \brief Whether the worker is (about to go) sleeping
+        std::atomic<bool> waiting{false};
+        /// \brief Set to stop the worker
+        std::atomic<bool> stopping{false};
+        /// \brief Guards sleeping of the worker
+        std::mutex sleep_mutex;
+        /// \brief Wakes up the worker
+        std::condition_variable wakeup;
+
+        /// \brief Amount of threads blocked in bus_job::wait()
+        std::atomic<size_t> done_waiters{0};
+        /// \brief Guards sleeping of threads waiting for a job
+        std::mutex done_mutex;
+        /// \brief Wakes up threads waiting for a job, after a batch is done
+        std::condition_variable done_signal;
+
+        /// \brief Worker thread
+        std::thread worker;
+
+    public:
+        /**
+         * \brief Create a shared bus, and start its worker thread
+         * @param bus The bus to share, should not be used directly anymore
+         */
+        explicit bus_shared(spi_base_bus &bus);
+
+        /**
+         * \brief Execute all remaining jobs, and stop the worker thread
+         */
+        ~bus_shared();
+
+        bus_shared(const bus_shared &) = delete;
+
+        bus_shared &operator=(const bus_shared &) = delete;
+
+        /**
+         * \brief Submit a job, can be called from any thread
+         * @param job Job to execute, should not be pending already
+         * @param csn Chip select to execute the job with
+         * @param merge Whether the job may be executed in the same transaction as the job before it, when that job uses the same csn
+         */
+        void submit(bus_job &job, hwlib::pin_out &csn, bool merge = false);
+
+        /**
+         * \brief Submit a job using a register-based chip select, can be called from any thread
+         * @param job Job to execute, should not be pending already
+         * @param csn Chip select to execute the job with
+         * @param merge Whether the job may be executed in the same transaction as the job before it, when that job uses the same csn
+         */
+        void submit(bus_job &job, const chip_select &csn, bool merge = false);
+
+    private:
+        friend class bus_job;
+
+        /**
+         * \brief Add a job to the queue, and wake up the worker if needed
+         * @param job Job with its chip select already set
+         * @param merge Whether the job may be executed in the same transaction as the job before it
+         */
+        void enqueue(bus_job &job, bool merge);
+
+        /**
+         * \brief Block until a job submitted to this bus is done
+         * @param job Job to wait for
+         */
+        void wait_for(const bus_job &job);
+
+        /**
+         * \brief Execute jobs in a single transaction, only called by the worker
+         * @param transaction Transaction to execute the jobs in
+         * @param job First job, replaced by the first job not executed (or nullptr)
+         * @param batch Memory location to store the executed jobs
+         * @return Amount of executed jobs
+         */
+        size_t execute_batch(spi_base_bus::spi_transaction &transaction, bus_job *&job, bus_job **batch);
+
+        /**
+         * \brief Add a node to the queue
+         */
+        void push(bus_job_node *node);
+
+        /**
+         * \brief Take the oldest job from the queue, only called by the worker
+         * @return The job, nullptr when no (completely submitted) job is available
+         */
+        bus_job *pop();
+
+        /**
+         * \brief Worker thread main loop
+         */
+        void run();
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_SHARED_HPP
@@ -67,6 +67,35 @@ namespace spi {
             }
         }
 
+        /**
+         * \brief Writes and reads from/to the buffers, followed by a CRC, calculating the CRC while copying
+         *
+         * \copydetails spi_base_bus::write_read_crc
+         */
+        bool write_read_crc(size_t n, const uint8_t *data_out, uint8_t *data_in, crc_base &crc, bool check) override {
+            for (size_t i = 0; i < n; i++) {
+                uint8_t out = (data_out != nullptr) ? *data_out++ : 0;
+                uint8_t in = in_buffer[in_buffer_index++];
+                out_buffer[out_buffer_size++] = out;
+                crc.update(check ? in : out);
+                if (data_in != nullptr) {
+                    *data_in++ = in;
+                }
+            }
+
+            uint8_t expected[2];
+            crc.value_bytes(expected);
+            bool match = true;
+            for (size_t i = 0; i < crc.size(); i++) {
+                uint8_t in = in_buffer[in_buffer_index++];
+                out_buffer[out_buffer_size++] = check ? 0 : expected[i];
+                if (check && in != expected[i]) {
+                    match = false;
+                }
+            }
+            return match;
+        }
+
     public:
         /**
          * \brief Append n items to the in_buffer
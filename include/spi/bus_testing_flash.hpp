@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_TESTING_FLASH_HPP
+#define IPASS_SPI_TESTING_FLASH_HPP
+
+#include <spi/bus_base.hpp>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief SPI-bus modelling a single SPI NOR flash, meant for testing
+     *
+     * Understands read (0x03), write enable (0x06), page program (0x02) and read status (0x05), with 24 bit addresses.
+     * Programming only clears bits, like real flash, and reports busy for a single status read afterwards.
+     * Counts transactions and read commands, so tests can check how much bus traffic was caused.
+     * @tparam memory_size Size of the flash in bytes
+     */
+    template<size_t memory_size = 4096>
+    class bus_testing_flash : public spi_base_bus {
+    public:
+        /// \brief Flash contents
+        std::array<uint8_t, memory_size> memory;
+        /// \brief Amount of transactions started
+        size_t transactions = 0;
+        /// \brief Amount of read commands received
+        size_t read_commands = 0;
+        /// \brief Amount of page program commands executed
+        size_t program_commands = 0;
+
+    private:
+        /// \brief Command of the current transaction
+        uint8_t command = 0;
+        /// \brief Amount of bytes transferred in the current transaction
+        size_t position = 0;
+        /// \brief Current address of the transaction
+        uint32_t address = 0;
+        /// \brief Write enable latch
+        bool write_enabled = false;
+        /// \brief Whether the next status read should report busy
+        bool busy = false;
+
+    public:
+        /**
+         * \brief Create an erased flash model
+         */
+        bus_testing_flash() : spi_base_bus(spi_mode(false, false, 1)) {
+            memory.fill(0xFF);
+        }
+
+    protected:
+        void onStart(spi_transaction &) override {
+            transactions++;
+            position = 0;
+            address = 0;
+        }
+
+        void onEnd(spi_transaction &) override {
+            if (command == 0x02 && position > 4) {
+                write_enabled = false;
+                busy = true;
+            }
+            command = 0;
+        }
+
+        /**
+         * \brief Interpret the written bytes as flash commands
+         * @param n Amount of bytes to transfer
+         * @param data_out Pointer to data to write
+         * @param data_in  Pointer to memory space to read into
+         */
+        void write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) override {
+            for (size_t i = 0; i < n; i++) {
+                uint8_t out = (data_out != nullptr) ? data_out[i] : 0;
+                uint8_t in = 0xFF;
+
+                if (position == 0) {
+                    command = out;
+                    if (command == 0x06) {
+                        write_enabled = true;
+                    } else if (command == 0x03) {
+                        read_commands++;
+                    } else if (command == 0x02 && write_enabled) {
+                        program_commands++;
+                    }
+                } else if ((command == 0x03 || command == 0x02) && position < 4) {
+                    address = (address << 8u) | out;
+                } else if (command == 0x03) {
+                    in = memory[address++ % memory_size];
+                } else if (command == 0x02 && write_enabled) {
+                    // Page program wraps around within the page
+                    uint32_t page = address & ~uint32_t(0xFF);
+                    memory[(page | ((address + position - 4) & 0xFFu)) % memory_size] &= out;
+                } else if (command == 0x05) {
+                    in = busy ? 0x01 : 0x00;
+                    busy = false;
+                }
+
+                position++;
+                if (data_in != nullptr) {
+                    data_in[i] = in;
+                }
+            }
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_TESTING_FLASH_HPP
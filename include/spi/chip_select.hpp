@@ -0,0 +1,80 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_CHIP_SELECT_HPP
+#define IPASS_SPI_CHIP_SELECT_HPP
+
+#include <hwlib.hpp>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief Chip select driven through a port's set/reset registers
+     *
+     * Selecting and deselecting is a single store to a register (e.g. BRR/BSRR on the STM32, CODR/SODR on the SAM3X),
+     * so it is atomic, and doesn't go through a virtual pin_out.
+     * Optionally waits for a setup time after selecting, and a hold time before deselecting.
+     */
+    class chip_select {
+        /// \brief Register to write mask to, to select the device
+        volatile uint32_t *select_register;
+        /// \brief Register to write mask to, to deselect the device
+        volatile uint32_t *deselect_register;
+        /// \brief Bit of the pin in the registers
+        uint32_t mask;
+        /// \brief Time to wait after selecting, before the first clock edge
+        uint32_t setup_ns;
+        /// \brief Time to wait after the last clock edge, before deselecting
+        uint32_t hold_ns;
+
+    public:
+        /**
+         * \brief Create a chip select from a pair of registers
+         * @param select_register Register to write mask to, to select the device (the reset register for active low CS)
+         * @param deselect_register Register to write mask to, to deselect the device
+         * @param mask Bit of the pin in the registers
+         * @param setup_ns Time to wait after selecting
+         * @param hold_ns Time to wait before deselecting
+         */
+        chip_select(volatile uint32_t *select_register, volatile uint32_t *deselect_register, uint32_t mask,
+                    uint32_t setup_ns = 0, uint32_t hold_ns = 0)
+                : select_register(select_register), deselect_register(deselect_register), mask(mask),
+                  setup_ns(setup_ns), hold_ns(hold_ns) {}
+
+        /**
+         * \brief Select the device
+         */
+        void select() const {
+            *select_register = mask;
+            if (setup_ns != 0) {
+                hwlib::wait_ns_busy(setup_ns);
+            }
+        }
+
+        /**
+         * \brief Deselect the device
+         */
+        void deselect() const {
+            if (hold_ns != 0) {
+                hwlib::wait_ns_busy(hold_ns);
+            }
+            *deselect_register = mask;
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_CHIP_SELECT_HPP
@@ -0,0 +1,209 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_CRC_HPP
+#define IPASS_SPI_CRC_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief Running CRC (up to 16 bits, MSBit first), as used by spi transactions
+     *
+     * The register is kept aligned to the top of 8 bits (width <= 8) or 16 bits, which is also how the STM32 SPI CRC unit keeps it.
+     * On the bus, every CRC is sent top aligned as well, MSByte first: a CRC that doesn't fill its last byte takes the top
+     * bits of it, and end_bits fills the unused low bits.
+     * The CRC keeps running over multiple transfers, until reset() is called.
+     */
+    class crc_base {
+    public:
+        /// \brief Width of the CRC in bits
+        const uint8_t width;
+        /// \brief Generator polynomial, without the top bit
+        const uint16_t polynomial;
+        /// \brief Initial value
+        const uint16_t initial;
+        /// \brief Value xor-ed with the register to get the final CRC
+        const uint16_t xor_out;
+        /// \brief Bits or-ed into the unused low bits of the last byte on the bus (e.g. the SD end bit)
+        const uint8_t end_bits;
+
+    protected:
+        /// \brief Current register value, top aligned
+        uint16_t reg;
+
+        /// \brief Amount of bits the register is shifted left compared to the CRC value
+        uint8_t shift() const {
+            return uint8_t((width <= 8 ? 8 : 16) - width);
+        }
+
+    public:
+        /**
+         * \brief Create a CRC, and reset it
+         * @param width Width in bits (1-16)
+         * @param polynomial Generator polynomial, without the top bit
+         * @param initial Initial value
+         * @param xor_out Value xor-ed with the register to get the final CRC
+         * @param end_bits Bits or-ed into the last byte on the bus
+         */
+        crc_base(uint8_t width, uint16_t polynomial, uint16_t initial, uint16_t xor_out, uint8_t end_bits = 0)
+                : width(width), polynomial(polynomial), initial(initial), xor_out(xor_out), end_bits(end_bits) {
+            reset();
+        }
+
+        /// \brief Restart calculation
+        void reset() {
+            reg = uint16_t(initial << shift());
+        }
+
+        /// \brief Get the final CRC value
+        uint16_t value() const {
+            return uint16_t((reg >> shift()) ^ xor_out);
+        }
+
+        /// \brief Get the amount of bytes the CRC takes on the bus
+        size_t size() const {
+            return (width + 7u) / 8u;
+        }
+
+        /**
+         * \brief Write the final CRC value as it is sent on the bus, MSByte first
+         *
+         * The CRC is top aligned: when width isn't a multiple of 8, the low bits of the last byte are end_bits.
+         * For example, crc7_mmc over CMD0 gives 0x95 ((0x4A << 1) | 1).
+         * @param out Memory location for size() bytes
+         */
+        void value_bytes(uint8_t *out) const {
+            auto v = uint16_t(reg ^ (xor_out << shift()));
+            if (size() == 2) {
+                *out++ = uint8_t(v >> 8u);
+            }
+            *out = uint8_t(v | end_bits);
+        }
+
+        /// \brief Get the raw (top aligned) register, for hardware CRC units
+        uint16_t get_register() const {
+            return reg;
+        }
+
+        /// \brief Set the raw (top aligned) register, for hardware CRC units
+        void set_register(uint16_t value) {
+            reg = value;
+        }
+
+        /**
+         * \brief Add a single byte to the calculation
+         * @param byte Byte to add
+         */
+        virtual void update(uint8_t byte) = 0;
+
+        /**
+         * \brief Add a buffer to the calculation
+         * @param n Size of the buffer
+         * @param data Buffer to add
+         */
+        virtual void update(size_t n, const uint8_t *data) = 0;
+    };
+
+    /**
+     * \brief Table driven CRC
+     *
+     * Bytes are added with a single table lookup, buffers four bytes at a time (slice-by-4).
+     * The tables are calculated at compile time.
+     * @tparam crc_width Width in bits (1-16)
+     * @tparam crc_polynomial Generator polynomial, without the top bit
+     * @tparam crc_initial Initial value
+     * @tparam crc_xor_out Value xor-ed with the register to get the final CRC
+     * @tparam crc_end_bits Bits or-ed into the unused low bits of the last byte on the bus
+     */
+    template<uint8_t crc_width, uint16_t crc_polynomial, uint16_t crc_initial = 0, uint16_t crc_xor_out = 0,
+            uint8_t crc_end_bits = 0>
+    class crc : public crc_base {
+        static_assert(crc_width >= 1 && crc_width <= 16, "Only CRCs up to 16 bits are supported");
+
+        /// \brief Type of the register
+        using reg_t = typename std::conditional<(crc_width <= 8), uint8_t, uint16_t>::type;
+        /// \brief Size of the register in bits
+        static constexpr unsigned bits = sizeof(reg_t) * 8;
+        /// \brief Lookup tables, table k gives the effect of a byte followed by k zero bytes
+        using tables_t = std::array<std::array<reg_t, 256>, 4>;
+
+        /// \brief Calculate the lookup tables
+        static constexpr tables_t make_tables() {
+            tables_t t = {};
+            const reg_t top = reg_t(1u << (bits - 1));
+            const reg_t poly = reg_t(crc_polynomial << (bits - crc_width));
+            for (unsigned i = 0; i < 256; i++) {
+                reg_t c = reg_t(i << (bits - 8));
+                for (unsigned j = 0; j < 8; j++) {
+                    c = (c & top) ? reg_t((c << 1u) ^ poly) : reg_t(c << 1u);
+                }
+                t[0][i] = c;
+            }
+            for (unsigned k = 1; k < 4; k++) {
+                for (unsigned i = 0; i < 256; i++) {
+                    reg_t previous = t[k - 1][i];
+                    t[k][i] = reg_t((previous << 8u) ^ t[0][previous >> (bits - 8)]);
+                }
+            }
+            return t;
+        }
+
+        /// \brief Lookup tables
+        static constexpr tables_t tables = make_tables();
+
+    public:
+        /// \brief Create a CRC, and reset it
+        crc() : crc_base(crc_width, crc_polynomial, crc_initial, crc_xor_out, crc_end_bits) {}
+
+        void update(uint8_t byte) override {
+            reg = reg_t((reg << 8u) ^ tables[0][uint8_t(reg >> (bits - 8)) ^ byte]);
+        }
+
+        void update(size_t n, const uint8_t *data) override {
+            auto r = reg_t(reg);
+            for (; n >= 4; n -= 4, data += 4) {
+                if (bits == 8) {
+                    r = reg_t(tables[3][uint8_t(r) ^ data[0]] ^ tables[2][data[1]] ^
+                              tables[1][data[2]] ^ tables[0][data[3]]);
+                } else {
+                    r = reg_t(tables[3][uint8_t(r >> 8u) ^ data[0]] ^ tables[2][uint8_t(r) ^ data[1]] ^
+                              tables[1][data[2]] ^ tables[0][data[3]]);
+                }
+            }
+            for (; n > 0; n--) {
+                r = reg_t((r << 8u) ^ tables[0][uint8_t(r >> (bits - 8)) ^ *data++]);
+            }
+            reg = r;
+        }
+    };
+
+    /// \brief CRC-7 as used by SD/MMC commands, sent with the end bit: (crc << 1) | 1
+    using crc7_mmc = crc<7, 0x09, 0, 0, 0x01>;
+    /// \brief CRC-8/SMBUS
+    using crc8_smbus = crc<8, 0x07>;
+    /// \brief CRC-16/XMODEM, as used by SD data blocks
+    using crc16_xmodem = crc<16, 0x1021>;
+    /// \brief CRC-16/CCITT-FALSE
+    using crc16_ccitt_false = crc<16, 0x1021, 0xFFFF>;
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_CRC_HPP
@@ -0,0 +1,169 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_DAISY_CHAIN_HPP
+#define IPASS_SPI_DAISY_CHAIN_HPP
+
+#include <spi/bus_base.hpp>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief Daisy-chained devices sharing a single chip select (74HC595 chains, LED drivers, chained ADCs)
+     *
+     * Keeps a shadow image of all devices. Changing a device only updates the image, and marks it dirty when the value changed.
+     * flush() shifts the whole chain in a single transfer, so any amount of updates before a flush costs one transfer.
+     * Device 0 is the device connected to MOSI, its data is shifted last. Data shifted back from the chain is stored
+     * in an input image with the same layout.
+     * @tparam device_count Amount of devices in the chain
+     * @tparam device_size Amount of bytes per device, sent MSByte first
+     */
+    template<size_t device_count, size_t device_size = 1>
+    class daisy_chain {
+        static_assert(device_count > 0 && device_size > 0, "A chain needs at least one device of at least one byte");
+
+        /// \brief Size of the whole chain in bytes
+        static constexpr size_t chain_size = device_count * device_size;
+
+        /// \brief Bus the chain is connected to
+        spi_base_bus &bus;
+        /// \brief Chip select (latch) of the chain
+        hwlib::pin_out &csn;
+        /// \brief Data to shift into the chain, in shift order
+        std::array<uint8_t, chain_size> out_image = {};
+        /// \brief Data shifted out of the chain during the last flush, in shift order
+        std::array<uint8_t, chain_size> in_image = {};
+        /// \brief Whether out_image changed since the last flush
+        bool dirty = true;
+        /// \brief Amount of value changes
+        uint32_t updates = 0;
+        /// \brief Amount of transfers done
+        uint32_t flushes = 0;
+
+        /// \brief Offset of a device in the images
+        static size_t offset(size_t device) {
+            return (device_count - 1 - device) * device_size;
+        }
+
+    public:
+        /**
+         * \brief Create a chain, with all devices set to 0
+         *
+         * The chain is marked dirty, so the first flush() always transfers.
+         * @param bus Bus the chain is connected to
+         * @param csn Chip select (latch) of the chain
+         */
+        daisy_chain(spi_base_bus &bus, hwlib::pin_out &csn) : bus(bus), csn(csn) {}
+
+        /**
+         * \brief Set the value of a device
+         * @param device Index of the device, 0 is connected to MOSI
+         * @param value device_size bytes, MSByte first
+         */
+        void set(size_t device, const uint8_t *value) {
+            uint8_t *target = out_image.data() + offset(device);
+            bool changed = false;
+            for (size_t i = 0; i < device_size; i++) {
+                if (target[i] != value[i]) {
+                    target[i] = value[i];
+                    changed = true;
+                }
+            }
+            if (changed) {
+                dirty = true;
+                updates++;
+            }
+        }
+
+        /**
+         * \brief Set a single output bit of a device
+         * @param device Index of the device, 0 is connected to MOSI
+         * @param bit Bit number, 0 is the least significant bit of the last byte
+         * @param value New level of the bit
+         */
+        void set_bit(size_t device, size_t bit, bool value) {
+            uint8_t &byte = out_image[offset(device) + device_size - 1 - bit / 8];
+            uint8_t mask = uint8_t(1u << (bit % 8));
+            uint8_t changed = value ? uint8_t(byte | mask) : uint8_t(byte & ~mask);
+            if (changed != byte) {
+                byte = changed;
+                dirty = true;
+                updates++;
+            }
+        }
+
+        /**
+         * \brief Get the value a device will have after the next flush
+         * @param device Index of the device, 0 is connected to MOSI
+         * @return Pointer to device_size bytes, MSByte first
+         */
+        const uint8_t *get(size_t device) const {
+            return out_image.data() + offset(device);
+        }
+
+        /**
+         * \brief Get the data shifted out of a device during the last transfer
+         * @param device Index of the device, 0 is connected to MOSI
+         * @return Pointer to device_size bytes, MSByte first
+         */
+        const uint8_t *get_input(size_t device) const {
+            return in_image.data() + offset(device);
+        }
+
+        /**
+         * \brief Check whether any device changed since the last transfer
+         */
+        bool is_dirty() const {
+            return dirty;
+        }
+
+        /**
+         * \brief Shift the whole chain, if anything changed since the last transfer
+         * @return True if a transfer was done
+         */
+        bool flush() {
+            if (!dirty) {
+                return false;
+            }
+            refresh();
+            return true;
+        }
+
+        /**
+         * \brief Shift the whole chain, even when nothing changed
+         *
+         * Used to read chained input devices.
+         */
+        void refresh() {
+            bus.transaction(csn).write_read(chain_size, out_image.data(), in_image.data());
+            dirty = false;
+            flushes++;
+        }
+
+        /// \brief Get the amount of value changes since construction
+        uint32_t get_updates() const {
+            return updates;
+        }
+
+        /// \brief Get the amount of transfers done since construction
+        uint32_t get_flushes() const {
+            return flushes;
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_DAISY_CHAIN_HPP
@@ -0,0 +1,306 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_FLASH_CACHE_HPP
+#define IPASS_SPI_FLASH_CACHE_HPP
+
+#include <spi/bus_base.hpp>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief Read-through block cache for SPI NOR flash (and devices with the same command set)
+     *
+     * Keeps line_count lines of line_size bytes, evicting the least recently used line on a miss.
+     * When two misses hit consecutive lines, the next line is read ahead in the same transaction.
+     * Writing through the cache invalidates the affected lines.
+     * All storage is part of the object, no dynamic allocation is done.
+     * @tparam line_size Size of a cache line in bytes
+     * @tparam line_count Amount of cache lines
+     */
+    template<size_t line_size = 32, size_t line_count = 8>
+    class flash_cache {
+        static_assert(line_count >= 2, "Readahead needs at least two cache lines");
+
+    public:
+        /// \brief Read data command
+        static constexpr uint8_t cmd_read = 0x03;
+        /// \brief Write enable command
+        static constexpr uint8_t cmd_write_enable = 0x06;
+        /// \brief Page program command
+        static constexpr uint8_t cmd_page_program = 0x02;
+        /// \brief Read status register command
+        static constexpr uint8_t cmd_read_status = 0x05;
+        /// \brief Write in progress bit of the status register
+        static constexpr uint8_t status_busy = 0x01;
+        /// \brief Size of a program page, programming can't cross a page boundary
+        static constexpr size_t page_size = 256;
+
+    private:
+        /**
+         * \brief A single cache line
+         */
+        struct line {
+            /// \brief Flash address of the first byte in this line
+            uint32_t address = 0;
+            /// \brief Value of the use counter at the last access, for LRU eviction
+            uint32_t last_used = 0;
+            /// \brief Whether this line contains data
+            bool valid = false;
+            /// \brief Cached data
+            std::array<uint8_t, line_size> data = {};
+        };
+
+        /// \brief Bus the flash is connected to
+        spi_base_bus &bus;
+        /// \brief Chip select of the flash
+        hwlib::pin_out &csn;
+        /// \brief Cache lines
+        std::array<line, line_count> lines;
+        /// \brief Incremented on every access, used as LRU timestamp
+        uint32_t use_counter = 0;
+        /// \brief Address of the line of the last miss, used to detect sequential reads
+        uint32_t last_miss = 0;
+        /// \brief Whether last_miss is set
+        bool have_last_miss = false;
+
+        /// \brief Amount of line accesses served from the cache
+        uint32_t hits = 0;
+        /// \brief Amount of line accesses that needed a flash read
+        uint32_t misses = 0;
+        /// \brief Amount of lines read ahead
+        uint32_t readaheads = 0;
+
+    public:
+        /**
+         * \brief Create a flash cache
+         * @param bus Bus the flash is connected to
+         * @param csn Chip select of the flash
+         */
+        flash_cache(spi_base_bus &bus, hwlib::pin_out &csn) : bus(bus), csn(csn) {}
+
+        /**
+         * \brief Read data through the cache
+         * @param address Flash address to start reading at
+         * @param n Amount of bytes to read
+         * @param data_in Memory location to read into
+         */
+        void read(uint32_t address, size_t n, uint8_t *data_in) {
+            while (n > 0) {
+                uint32_t line_address = address - (address % line_size);
+                size_t offset = address - line_address;
+                size_t count = line_size - offset;
+                if (count > n) {
+                    count = n;
+                }
+
+                const line &l = fetch(line_address);
+                for (size_t i = 0; i < count; i++) {
+                    *data_in++ = l.data[offset + i];
+                }
+
+                address += count;
+                n -= count;
+            }
+        }
+
+        /**
+         * \brief Program data into the flash, invalidating the cached lines it covers
+         *
+         * Splits the data on page boundaries, and waits for every page to finish programming.
+         * The affected area should be erased beforehand.
+         * @param address Flash address to start writing at
+         * @param n Amount of bytes to write
+         * @param data_out Data to write
+         */
+        void write(uint32_t address, size_t n, const uint8_t *data_out) {
+            invalidate(address, n);
+
+            while (n > 0) {
+                size_t count = page_size - (address % page_size);
+                if (count > n) {
+                    count = n;
+                }
+
+                bus.transaction(csn).write_byte(cmd_write_enable);
+                uint8_t header[4];
+                make_header(cmd_page_program, address, header);
+                bus.transaction(csn).write(4, header).write(count, data_out);
+                wait_ready();
+
+                address += count;
+                data_out += count;
+                n -= count;
+            }
+        }
+
+        /**
+         * \brief Invalidate all cached lines overlapping an area
+         *
+         * Should be called when the flash is changed without going through this cache (e.g. erasing).
+         * @param address Start of the area
+         * @param n Size of the area in bytes
+         */
+        void invalidate(uint32_t address, size_t n) {
+            for (line &l : lines) {
+                if (l.valid && l.address < address + n && address < l.address + line_size) {
+                    l.valid = false;
+                }
+            }
+            have_last_miss = false;
+        }
+
+        /**
+         * \brief Invalidate the whole cache
+         */
+        void invalidate_all() {
+            for (line &l : lines) {
+                l.valid = false;
+            }
+            have_last_miss = false;
+        }
+
+        /// \brief Get the amount of line accesses served from the cache
+        uint32_t get_hits() const {
+            return hits;
+        }
+
+        /// \brief Get the amount of line accesses that needed a flash read
+        uint32_t get_misses() const {
+            return misses;
+        }
+
+        /// \brief Get the amount of lines that were read ahead
+        uint32_t get_readaheads() const {
+            return readaheads;
+        }
+
+        /// \brief Reset the hit, miss and readahead counters
+        void clear_counters() {
+            hits = 0;
+            misses = 0;
+            readaheads = 0;
+        }
+
+    private:
+        /**
+         * \brief Build a command header with a 24 bit address
+         * @param command Command byte
+         * @param address Flash address
+         * @param header Memory location for the 4 header bytes
+         */
+        static void make_header(uint8_t command, uint32_t address, uint8_t *header) {
+            header[0] = command;
+            header[1] = uint8_t(address >> 16u);
+            header[2] = uint8_t(address >> 8u);
+            header[3] = uint8_t(address);
+        }
+
+        /**
+         * \brief Poll the status register until the flash is done programming
+         */
+        void wait_ready() {
+            uint8_t status;
+            do {
+                auto transaction = bus.transaction(csn);
+                transaction.write_byte(cmd_read_status);
+                status = transaction.read_byte();
+            } while ((status & status_busy) != 0);
+        }
+
+        /**
+         * \brief Find the cached line for an address
+         * @param line_address Line aligned flash address
+         * @return The line, or nullptr when it isn't cached
+         */
+        line *find(uint32_t line_address) {
+            for (line &l : lines) {
+                if (l.valid && l.address == line_address) {
+                    return &l;
+                }
+            }
+            return nullptr;
+        }
+
+        /**
+         * \brief Choose a line to evict
+         * @param keep Line that may not be chosen, nullptr if any line is allowed
+         * @return An invalid line if there is one, otherwise the least recently used one
+         */
+        line &victim(const line *keep) {
+            line *oldest = nullptr;
+            for (line &l : lines) {
+                if (&l == keep) {
+                    continue;
+                }
+                if (!l.valid) {
+                    return l;
+                }
+                if (oldest == nullptr || l.last_used < oldest->last_used) {
+                    oldest = &l;
+                }
+            }
+            return *oldest;
+        }
+
+        /**
+         * \brief Get a line from the cache, reading it (and possibly the next one) from flash on a miss
+         * @param line_address Line aligned flash address
+         * @return The cached line
+         */
+        const line &fetch(uint32_t line_address) {
+            line *l = find(line_address);
+            if (l != nullptr) {
+                hits++;
+                l->last_used = ++use_counter;
+                return *l;
+            }
+            misses++;
+
+            bool sequential = have_last_miss && line_address == last_miss + line_size;
+            last_miss = line_address;
+            have_last_miss = true;
+
+            l = &victim(nullptr);
+            l->address = line_address;
+            l->valid = true;
+            l->last_used = ++use_counter;
+
+            uint8_t header[4];
+            make_header(cmd_read, line_address, header);
+            auto transaction = bus.transaction(csn);
+            transaction.write(4, header).read(line_size, l->data.data());
+
+            // The flash keeps streaming, so the next line costs no extra command or address
+            uint32_t next_address = line_address + line_size;
+            if (sequential && find(next_address) == nullptr) {
+                line &next = victim(l);
+                next.address = next_address;
+                next.valid = true;
+                next.last_used = use_counter;
+                transaction.read(line_size, next.data.data());
+                readaheads++;
+
+                // A miss right after the read-ahead line continues the same sequence
+                last_miss = next_address;
+            }
+            return *l;
+        }
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_FLASH_CACHE_HPP
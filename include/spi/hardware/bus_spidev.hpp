@@ -0,0 +1,203 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_SPIDEV_HPP
+#define IPASS_SPI_SPIDEV_HPP
+
+#include <hwlib.hpp>
+#include <spi/bus_base.hpp>
+#include <linux/spi/spidev.h>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief System call layer used by bus_spidev
+     *
+     * Can be replaced by a fake to test code using bus_spidev without hardware.
+     */
+    class spidev_io {
+    public:
+        /**
+         * \brief Open a device file
+         * @param path Path of the device
+         * @return File descriptor, or -1 on failure (errno set)
+         */
+        virtual int open(const char *path) = 0;
+
+        /**
+         * \brief Close a file descriptor
+         * @param fd File descriptor to close
+         */
+        virtual void close(int fd) = 0;
+
+        /**
+         * \brief Perform an ioctl
+         * @param fd File descriptor of the device
+         * @param request Request code (SPI_IOC_*)
+         * @param arg Argument of the request
+         * @return Result of the ioctl, negative on failure (errno set)
+         */
+        virtual int ioctl(int fd, unsigned long request, void *arg) = 0;
+    };
+
+    /**
+     * \brief spidev_io using the real Linux system calls
+     */
+    class spidev_io_linux : public spidev_io {
+    public:
+        int open(const char *path) override;
+
+        void close(int fd) override;
+
+        int ioctl(int fd, unsigned long request, void *arg) override;
+
+        /// \brief Shared instance, used by default
+        static spidev_io_linux instance;
+    };
+
+    /**
+     * \brief SPI implementation using the Linux spidev driver (/dev/spidevX.Y)
+     *
+     * Transfers within a transaction are collected as segments, and sent together in a single SPI_IOC_MESSAGE ioctl when the transaction ends.
+     * That ioctl also releases CS, so a command followed by a read (e.g. write(4, header).read(n, data)) takes one ioctl.
+     * Reads are postponed as well: data read only lands in its buffer when the transaction ends.
+     * Call complete() on the transaction when the data is needed earlier, read_byte() and read_crc() do this themselves.
+     * Running out of segments or staging space, or writing more than staging_size bytes at once, sends the collected segments early.
+     * Chip select is handled by the driver, CS stays asserted between ioctls of the same transaction.
+     * Supports all operating modes, including LSBit first.
+     */
+    class bus_spidev : public spi_base_bus {
+    public:
+        /// \brief Maximum amount of segments in a single ioctl
+        static constexpr size_t max_segments = 16;
+        /// \brief Size of the buffer holding the data of collected writes
+        static constexpr size_t staging_size = 256;
+
+    private:
+        /// \brief System call layer
+        spidev_io &io;
+        /// \brief File descriptor of the device, -1 when not open
+        int fd = -1;
+        /// \brief errno of the last failed system call, 0 if none failed
+        int error = 0;
+
+        /// \brief Collected segments
+        spi_ioc_transfer segments[max_segments] = {};
+        /// \brief Amount of collected segments
+        size_t segment_count = 0;
+        /// \brief Copies of the data of collected writes, the caller's buffers may be gone before they are sent
+        uint8_t staging[staging_size] = {0};
+        /// \brief Amount of used bytes in staging
+        size_t staging_used = 0;
+        /// \brief Whether the driver kept CS asserted after the last ioctl
+        bool selected = false;
+
+    public:
+        /**
+         * \brief Open a spidev device
+         *
+         * Check get_error() to see whether opening and configuring succeeded.
+         * @param path Path of the device, e.g. /dev/spidev0.0
+         * @param mode SPI mode to use
+         * @param io System call layer, the real one by default
+         */
+        bus_spidev(const char *path, spi_mode mode, spidev_io &io = spidev_io_linux::instance);
+
+        /**
+         * \brief Close the device
+         */
+        ~bus_spidev();
+
+        bus_spidev(const bus_spidev &) = delete;
+
+        bus_spidev &operator=(const bus_spidev &) = delete;
+
+        /**
+         * \brief Change the operating mode
+         *
+         * Should not be called during a transaction.
+         * @param new_mode Mode to use
+         */
+        void set_mode(spi_mode new_mode);
+
+        /**
+         * \brief Get the errno of the last failed system call
+         * @return errno value, 0 when no call failed
+         */
+        int get_error() const;
+
+        using spi_base_bus::transaction;
+
+        /**
+         * \brief Start a transaction, chip select is handled by the driver
+         * @return The transaction created
+         */
+        spi_transaction transaction();
+
+    protected:
+        /**
+         * \brief Collects a segment, sends immediately when the data to write is too big to copy
+         * @param n Amount of bytes to transfer
+         * @param data_out Pointer to data to write
+         * @param data_in  Pointer to memory location to read into
+         */
+        void write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) override;
+
+        /**
+         * \brief spidev supports SPI_LSB_FIRST
+         * @return true
+         */
+        bool native_lsb_first() const override;
+
+        /**
+         * \brief Sends all collected segments, keeping CS asserted
+         */
+        void complete_reads() override;
+
+        /**
+         * \brief Nothing to do, CS is asserted by the first ioctl
+         * @param transaction The starting transaction
+         */
+        void onStart(spi_transaction &transaction) override;
+
+        /**
+         * \brief Sends all collected segments, and releases CS
+         * @param transaction The ending transaction
+         */
+        void onEnd(spi_transaction &transaction) override;
+
+    private:
+        /**
+         * \brief Send all collected segments in a single ioctl
+         * @param keep_selected Whether CS should stay asserted after the message
+         */
+        void flush(bool keep_selected);
+
+        /**
+         * \brief Clock speed for the current mode
+         * @return Speed in Hz, 0 to use the driver's default
+         */
+        uint32_t speed_hz() const;
+
+        /**
+         * \brief Write the current mode to the driver
+         */
+        void configure();
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_SPIDEV_HPP
@@ -19,25 +19,72 @@ namespace spi {
      * @{
      */
 
+    /**
+     * \brief Receiver of streaming events for bus_stm32f10xxx
+     *
+     * Called from the DMA interrupt, so implementations should be short.
+     */
+    class stream_handler {
+    public:
+        /**
+         * \brief Called every time half of the stream buffer has been transferred
+         *
+         * While this is running, the DMA is transferring the other half.
+         * The handler should drain rx and refill tx before the DMA wraps around to this half again.
+         * @param tx The half of the transmit buffer that was just sent, nullptr when only receiving
+         * @param rx The half of the receive buffer that was just filled, nullptr when only sending
+         * @param n Size of the half in bytes
+         */
+        virtual void stream_half(uint8_t *tx, const uint8_t *rx, size_t n) = 0;
+    };
+
     /**
      * \brief Hardware SPI implementation for the STM32 Bluepill
      *
      * Uses hardware SPI1, and DMA, for extra fast transfer.
-     * Unfortunately this bus doesn't support other modes than the default one.
+     * Unfortunately this bus doesn't support other modes than the default one, apart from the bit order, which is set in hardware.
      * Uses the default SPI1 pins (A4-A7 (CSN,CLK,MISO,MOSI)
+     * Transactions can use A4 (default, or driven by the SPI peripheral as hardware NSS), any chip_select, or any hwlib pin as chip select.
+     *
+     * Besides transactions, supports continuous streaming, using DMA1 in circular mode over a double buffer.
      */
     class bus_stm32f10xxx : public spi_base_bus {
         /// \brief 32 Free 0 bytes, for when only reading
         uint8_t data_out_empty[32] = {0};
 
+        /// \brief Chip select on A4, used when a transaction doesn't set one
+        chip_select default_csn;
+        /// \brief Whether A4 is driven by the SPI peripheral (NSS output) instead of default_csn
+        bool hardware_nss;
+
+        /// \brief Target of the receive DMA when streaming without a receive buffer
+        uint8_t stream_rx_discard = 0;
+        /// \brief Handler receiving the streaming events, nullptr when not streaming
+        stream_handler *volatile handler = nullptr;
+        /// \brief Transmit buffer of the stream
+        uint8_t *stream_tx = nullptr;
+        /// \brief Receive buffer of the stream
+        uint8_t *stream_rx = nullptr;
+        /// \brief Size of half of the stream buffers
+        size_t stream_half_size = 0;
+        /// \brief Amount of halves that were transferred since the stream started
+        volatile uint32_t halves = 0;
+        /// \brief Amount of halves that were overwritten or resent before the handler was done with them
+        volatile uint32_t overruns = 0;
+
+        /// \brief The bus currently streaming, used by the DMA interrupt
+        static bus_stm32f10xxx *volatile streaming_bus;
+
     public:
         /**
          * \brief Create a Blue_pill spi bus
          *
          * Sets pins A4-A7 to their right mode for SPI transfer, prepares DMA1 channels 2 and 3 for SPI transfer.
          * @param mode SPI Mode to use, as stated before, changing this has no effect now
+         * @param hardware_nss Let the SPI peripheral drive A4 (NSS), the peripheral is then only enabled during transactions.
+         * Since NSS is asserted whenever the peripheral is enabled, A4 is then used for every transaction.
          */
-        bus_stm32f10xxx(spi_mode mode);
+        bus_stm32f10xxx(spi_mode mode, bool hardware_nss = false);
 
     private:
         /**
@@ -50,21 +97,109 @@ namespace spi {
          */
         void write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) override;
 
+        /**
+         * \brief Transfer data followed by its CRC, using the CRC unit of the peripheral where possible
+         *
+         * The hardware unit is used for 8 bit CRCs without final xor or end bits, when the CRC register is 0, the mode is MSBit first, and hardware NSS isn't used.
+         * Other CRCs are calculated in software after the transfer.
+         * \copydetails spi_base_bus::write_read_crc
+         */
+        bool write_read_crc(size_t n, const uint8_t *data_out, uint8_t *data_in, crc_base &crc, bool check) override;
+
+        /**
+         * \brief Bit order is set through SPI_CR1_LSBFIRST
+         * @return true
+         */
+        bool native_lsb_first() const override;
+
+    public:
+        /**
+         * \brief Start continuously streaming
+         *
+         * Selects the device on A4, and transfers tx and rx in circles until stream_stop() is called.
+         * The handler is called from the DMA interrupt after every half of the buffers.
+         * No transactions should be started while streaming.
+         * @param n Total size of the buffers, should be even, and between 2 and 65534
+         * @param tx Transmit buffer, or nullptr to only receive (zeroes are sent)
+         * @param rx Receive buffer, or nullptr to only send
+         * @param handler Handler for the half-transfer and transfer-complete events
+         * @return False if n is invalid, nothing is started then
+         */
+        bool stream_start(size_t n, uint8_t *tx, uint8_t *rx, stream_handler &handler);
+
+        /**
+         * \brief Stop streaming
+         *
+         * Waits for the byte in progress, and deselects the device on A4.
+         */
+        void stream_stop();
+
+        /**
+         * \brief Get the amount of halves transferred since the last stream_start()
+         */
+        uint32_t stream_halves() const;
+
+        /**
+         * \brief Get the amount of overruns/underruns since the last stream_start()
+         *
+         * Counts halves the DMA reached again before the handler was done with them, halves that were skipped entirely,
+         * and receive overruns of the SPI peripheral.
+         */
+        uint32_t stream_overruns() const;
+
+        /**
+         * \brief Handle the DMA1 channel 2 interrupt for streaming
+         *
+         * Should be called from DMA1_Channel2_IRQHandler. The library only defines that handler when SPI_STREAM_IRQ=1 is set
+         * before including Makefile.inc, so applications defining it themselves should call this from their handler.
+         */
+        static void handle_dma_interrupt();
+
+    private:
+        /**
+         * \brief Handle the DMA interrupt for the stream of this bus
+         */
+        void stream_interrupt();
+
     protected:
         /**
-         * \brief Pulls CSN low, ignores the set CSN pin
+         * \brief Selects the transaction's chip_select or CSN pin, or A4 when neither is set or hardware NSS is used
          * @param transaction The starting transaction
          */
         void onStart(spi_transaction &transaction) override;
 
         /**
-         * \brief Pulls CSN high, ignores the set CSN pin
+         * \brief Deselects the transaction's chip_select or CSN pin, or A4 when neither is set or hardware NSS is used
          * @param transaction The ending transaction
          */
         void onEnd(spi_transaction &transaction) override;
 
+    private:
+        /**
+         * \brief Select the device on A4
+         */
+        void select_default();
+
+        /**
+         * \brief Deselect the device on A4
+         */
+        void deselect_default();
+
     };
 
+    /**
+     * \brief Create a chip_select for any pin of the STM32F10xxx
+     *
+     * Enables the clock of the port, configures the pin as push-pull output, and deselects it.
+     * The chip select is active low, selecting writes BRR, deselecting writes BSRR.
+     * @param port GPIO port of the pin (GPIOA, GPIOB, ...)
+     * @param pin Pin number within the port (0-15)
+     * @param setup_ns Time to wait after selecting
+     * @param hold_ns Time to wait before deselecting
+     * @return The chip select
+     */
+    chip_select stm32_chip_select(GPIO_TypeDef *port, uint8_t pin, uint32_t setup_ns = 0, uint32_t hold_ns = 0);
+
     /**
      * @}
      */
@@ -0,0 +1,163 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_BLUE_PILL_SLAVE_HPP
+#define IPASS_SPI_BLUE_PILL_SLAVE_HPP
+
+#include <hwlib.hpp>
+#include <spi/bus_base.hpp>
+#include <spi/slave_ring.hpp>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief Hardware SPI slave implementation for the STM32 Bluepill
+     *
+     * Uses hardware SPI2, so it can be used together with bus_stm32f10xxx (on SPI1).
+     * Uses the default SPI2 pins (B12-B15 (NSS,CLK,MISO,MOSI)), NSS is driven by the master.
+     * Everything the master sends is received into a ring buffer by DMA1 channel 4 in circular mode, and can be consumed
+     * without copying through peek() and consume().
+     * A response for the next frame can be queued at any time, it is loaded into DMA1 channel 5 when NSS goes high.
+     * Only one slave bus can exist at a time.
+     * The library only defines DMA1_Channel4_IRQHandler and EXTI15_10_IRQHandler when SPI_SLAVE_IRQ=1 is set before
+     * including Makefile.inc. Otherwise, call handle_dma_interrupt() and handle_nss_interrupt() from your own handlers.
+     */
+    class bus_stm32f10xxx_slave {
+        /// \brief Consumer side of the receive ring buffer
+        slave_ring ring;
+
+        /// \brief Byte sent when no response is queued
+        uint8_t idle_byte;
+        /// \brief CR1 configuration (without SPE), reapplied after resetting the peripheral
+        uint32_t cr1_config = 0;
+        /// \brief Response for the next frame, nullptr when none is queued
+        const uint8_t *volatile next_response = nullptr;
+        /// \brief Size of the queued response
+        volatile size_t next_response_size = 0;
+        /// \brief Amount of frames (NSS low-high cycles) seen
+        volatile uint32_t frame_count = 0;
+        /// \brief Amount of frames that ended without a response queued for the next one
+        volatile uint32_t missed_responses = 0;
+
+        /// \brief The slave bus, used by the interrupts
+        static bus_stm32f10xxx_slave *volatile instance;
+
+    public:
+        /**
+         * \brief Create a Blue_pill spi slave bus
+         *
+         * Sets pins B12-B15 to their right mode, starts receiving into the ring buffer,
+         * and enables the DMA and NSS (EXTI12) interrupts.
+         * @param buffer Ring buffer to receive into, should stay alive as long as the bus
+         * @param size Size of the ring buffer, should be even
+         * @param mode SPI mode to use, the timing is ignored since the master drives the clock
+         * @param idle_byte Byte sent when no response is queued
+         */
+        bus_stm32f10xxx_slave(uint8_t *buffer, size_t size, spi_mode mode, uint8_t idle_byte = 0xFF);
+
+        /**
+         * \brief Disable the peripheral, DMA and interrupts
+         */
+        ~bus_stm32f10xxx_slave();
+
+        bus_stm32f10xxx_slave(const bus_stm32f10xxx_slave &) = delete;
+
+        bus_stm32f10xxx_slave &operator=(const bus_stm32f10xxx_slave &) = delete;
+
+        /**
+         * \brief Get the oldest received data that isn't consumed yet
+         *
+         * \copydetails slave_ring::peek()
+         */
+        slave_span peek();
+
+        /**
+         * \brief Mark received data as consumed
+         * @param n Amount of bytes to consume, at most the size of the last peek()
+         */
+        void consume(size_t n);
+
+        /**
+         * \brief Get the amount of received bytes that aren't consumed yet
+         */
+        size_t available();
+
+        /**
+         * \brief Queue the response for the next frame
+         *
+         * The data is sent as-is (not copied), so it should stay unchanged until the frame after it starts.
+         * When the master clocks more bytes than the response holds, the last byte is repeated.
+         * @param data Response to send
+         * @param n Size of the response
+         */
+        void queue_response(const uint8_t *data, size_t n);
+
+        /**
+         * \brief Get the amount of times received data was dropped because it wasn't consumed in time
+         */
+        uint32_t overflows() const;
+
+        /**
+         * \brief Get the amount of frames seen since construction
+         */
+        uint32_t frames() const;
+
+        /**
+         * \brief Get the amount of frames that started without a response queued
+         */
+        uint32_t responses_missed() const;
+
+        /**
+         * \brief Handle the DMA1 channel 4 interrupt
+         *
+         * Should be called from DMA1_Channel4_IRQHandler.
+         */
+        static void handle_dma_interrupt();
+
+        /**
+         * \brief Handle the NSS (EXTI line 12) interrupt
+         *
+         * Should be called from EXTI15_10_IRQHandler. Only clears EXTI line 12, other lines are left to the application.
+         */
+        static void handle_nss_interrupt();
+
+    private:
+        /**
+         * \brief Handle the receive DMA interrupt
+         */
+        void dma_interrupt();
+
+        /**
+         * \brief Handle NSS going high, load the next response
+         */
+        void nss_interrupt();
+
+        /**
+         * \brief Write the configuration to the peripheral, and enable it
+         */
+        void enable();
+
+        /**
+         * \brief Point the transmit DMA at a response
+         * @param data Response to send, nullptr to send idle_byte
+         * @param n Size of the response
+         */
+        void load_response(const uint8_t *data, size_t n);
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_BLUE_PILL_SLAVE_HPP
@@ -0,0 +1,292 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_LOGIC_ANALYZER_HPP
+#define IPASS_SPI_LOGIC_ANALYZER_HPP
+
+#include <spi/bus_bitbang.hpp>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief Channels recorded by the logic_analyzer
+     */
+    enum class analyzer_channel : uint8_t {
+        sclk = 0,
+        mosi = 1,
+        miso = 2,
+        csn = 3
+    };
+
+    /**
+     * \brief Virtual logic analyzer, meant for measuring SPI timing on the host
+     *
+     * Keeps a virtual clock, which is only advanced by waits and (optionally) by a fixed cost for every pin operation.
+     * Every level change on a channel is timestamped against this clock.
+     * The recording can be exported as a VCD file, or used to calculate the achieved bit rate and duty cycle.
+     */
+    class logic_analyzer {
+    public:
+        /// \brief Amount of channels recorded
+        static constexpr size_t channel_count = 4;
+        /// \brief Maximum amount of edges that can be recorded, further edges are dropped
+        static constexpr size_t max_edges = 4096;
+
+        /**
+         * \brief A single level change on a channel
+         */
+        struct edge {
+            /// \brief Virtual time of the change in nanoseconds
+            uint_fast64_t time_ns;
+            /// \brief Channel that changed
+            analyzer_channel channel;
+            /// \brief New level of the channel
+            bool level;
+        };
+
+    private:
+        /// \brief Recorded edges, in order of time
+        std::array<edge, max_edges> edges = {};
+        /// \brief Amount of recorded edges
+        size_t edge_count = 0;
+        /// \brief Amount of edges that didn't fit in the buffer
+        size_t dropped = 0;
+        /// \brief Current virtual time in nanoseconds
+        uint_fast64_t now = 0;
+        /// \brief Virtual cost of a single pin operation in nanoseconds
+        uint32_t pin_op_ns;
+        /// \brief Last recorded level for every channel
+        std::array<bool, channel_count> levels = {};
+        /// \brief Whether a level was recorded for a channel yet
+        std::array<bool, channel_count> seen = {};
+
+    public:
+        /**
+         * \brief Create a logic analyzer
+         * @param pin_op_ns Time in nanoseconds a single pin read or write takes on the modelled hardware
+         */
+        explicit logic_analyzer(uint32_t pin_op_ns = 0);
+
+        /**
+         * \brief Get the current virtual time
+         * @return Virtual time in nanoseconds
+         */
+        uint_fast64_t now_ns() const;
+
+        /**
+         * \brief Advance the virtual clock
+         * @param ns Amount of nanoseconds to advance
+         */
+        void advance(uint32_t ns);
+
+        /**
+         * \brief Record a pin operation on a channel
+         *
+         * Charges the pin operation cost to the virtual clock, and stores an edge when the level changed.
+         * @param channel Channel the operation happened on
+         * @param level Level of the channel after the operation
+         */
+        void record(analyzer_channel channel, bool level);
+
+        /**
+         * \brief Get the last recorded level of a channel
+         * @param channel Channel to check
+         * @return Level of the channel, false when nothing was recorded yet
+         */
+        bool level(analyzer_channel channel) const;
+
+        /**
+         * \brief Remove all recorded edges and reset the virtual clock
+         */
+        void clear();
+
+        /// \brief Get the amount of recorded edges
+        size_t get_edge_count() const;
+
+        /// \brief Get a recorded edge by index
+        const edge &get_edge(size_t index) const;
+
+        /// \brief Get the amount of edges that were dropped because the buffer was full
+        size_t get_dropped() const;
+
+        /**
+         * \brief Get the amount of complete clock cycles measured while CSN was low
+         */
+        uint32_t clock_cycles() const;
+
+        /**
+         * \brief Get the average duration of a clock cycle while CSN was low
+         *
+         * Includes any gaps between bytes, since these are part of the achieved speed.
+         * @return Average period in nanoseconds, 0 when less than two rising edges were recorded
+         */
+        uint_fast64_t average_period_ns() const;
+
+        /**
+         * \brief Get the achieved bit rate
+         * @return Bits per second, 0 when no complete clock cycles were recorded
+         */
+        uint32_t bit_rate() const;
+
+        /**
+         * \brief Get the duty cycle of the clock
+         * @return Percentage of the clock period SCLK was high
+         */
+        uint8_t duty_cycle() const;
+
+        /**
+         * \brief Get the time per bit spent on anything else than the configured waits
+         * @param mode The mode the bus was configured with
+         * @return Nanoseconds per bit more than 2 * mode.half_time_ns
+         */
+        uint_fast64_t wasted_ns_per_bit(const spi_mode &mode) const;
+
+        /**
+         * \brief Write the recording as a Value Change Dump
+         *
+         * Timescale is 1ns. Works with any stream supporting << for strings, characters and integers (hwlib::ostream, std::ostream)
+         * @tparam OUT Type of the stream
+         * @param out Stream to write to
+         */
+        template<typename OUT>
+        void write_vcd(OUT &out) const {
+            static const char *const names[channel_count] = {"sclk", "mosi", "miso", "csn"};
+
+            out << "$timescale 1ns $end\n";
+            out << "$scope module spi $end\n";
+            for (size_t i = 0; i < channel_count; i++) {
+                out << "$var wire 1 " << char('!' + i) << ' ' << names[i] << " $end\n";
+            }
+            out << "$upscope $end\n";
+            out << "$enddefinitions $end\n";
+            out << "#0\n$dumpvars\n";
+            for (size_t i = 0; i < channel_count; i++) {
+                out << 'x' << char('!' + i) << '\n';
+            }
+            out << "$end\n";
+
+            bool first = true;
+            uint_fast64_t last_time = 0;
+            for (size_t i = 0; i < edge_count; i++) {
+                const edge &e = edges[i];
+                if (first || e.time_ns != last_time) {
+                    out << '#' << static_cast<unsigned long long>(e.time_ns) << '\n';
+                    last_time = e.time_ns;
+                    first = false;
+                }
+                out << (e.level ? '1' : '0') << char('!' + static_cast<uint8_t>(e.channel)) << '\n';
+            }
+        }
+
+    private:
+        /**
+         * \brief Sum up all clock cycles measured while CSN was low
+         * @param period_total Total duration of the cycles in nanoseconds
+         * @param high_total Total time SCLK was high during these cycles
+         * @return Amount of cycles
+         */
+        uint32_t measure_cycles(uint_fast64_t &period_total, uint_fast64_t &high_total) const;
+    };
+
+    /**
+     * \brief Output pin that records its writes in a logic_analyzer
+     */
+    class analyzer_pin_out : public hwlib::pin_out {
+        /// \brief Analyzer to record into
+        logic_analyzer &analyzer;
+        /// \brief Channel of this pin
+        analyzer_channel channel;
+    public:
+        /**
+         * \brief Create a recording output pin
+         * @param analyzer Analyzer to record into
+         * @param channel Channel of this pin
+         */
+        analyzer_pin_out(logic_analyzer &analyzer, analyzer_channel channel);
+
+        /// \brief Write a level, and record it
+        void write(bool v) override;
+
+        /// \brief Get the last written level
+        bool get() const;
+    };
+
+    /**
+     * \brief Input pin that records its reads in a logic_analyzer
+     *
+     * Returns either a fixed level, or the level of an analyzer_pin_out (e.g. MOSI for loopback testing).
+     */
+    class analyzer_pin_in : public hwlib::pin_in {
+        /// \brief Analyzer to record into
+        logic_analyzer &analyzer;
+        /// \brief Channel of this pin
+        analyzer_channel channel;
+        /// \brief Level returned when there is no loopback source
+        bool value = false;
+        /// \brief Optional pin to mirror the level of
+        const analyzer_pin_out *source = nullptr;
+    public:
+        /**
+         * \brief Create a recording input pin
+         * @param analyzer Analyzer to record into
+         * @param channel Channel of this pin
+         */
+        analyzer_pin_in(logic_analyzer &analyzer, analyzer_channel channel);
+
+        /// \brief Read the current level, and record it
+        bool read() override;
+
+        /// \brief Set the level returned by read()
+        void set(bool v);
+
+        /**
+         * \brief Mirror the level of an output pin
+         * @param pin Pin to mirror, nullptr to return the set level again
+         */
+        void loopback(const analyzer_pin_out *pin);
+    };
+
+    /**
+     * \brief Bitbang bus which advances a logic_analyzer's virtual clock instead of busy waiting
+     *
+     * Calibrates against the virtual clock, and clears the analyzer afterwards, so the recording starts at the first transaction.
+     */
+    class bus_bitbang_analyzed : public bus_bitbang {
+        /// \brief Analyzer whose clock is advanced
+        logic_analyzer &analyzer;
+    public:
+        /**
+         * \brief Create an analyzed bitbang bus
+         * @param analyzer Analyzer the pins record into
+         * @param _sclk Clock Pin
+         * @param _mosi Master out slave in pin
+         * @param _miso Master In Slave Out pin
+         * @param mode SPI_Mode to use
+         */
+        bus_bitbang_analyzed(logic_analyzer &analyzer, analyzer_pin_out &_sclk, analyzer_pin_out &_mosi,
+                             analyzer_pin_in &_miso, const spi_mode &mode);
+
+    protected:
+        /// \brief Advance the virtual clock instead of waiting
+        void delay_ns(uint32_t ns) override;
+
+        /// \brief Get the virtual time of the analyzer
+        uint_fast64_t now_ns() override;
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_LOGIC_ANALYZER_HPP
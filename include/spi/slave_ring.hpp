@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_SLAVE_RING_HPP
+#define IPASS_SPI_SLAVE_RING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace spi {
+    /**
+     * \addtogroup spi_ex
+     * @{
+     */
+
+    /**
+     * \brief Contiguous piece of received data, pointing into the ring buffer
+     */
+    struct slave_span {
+        /// \brief First byte
+        const uint8_t *data;
+        /// \brief Amount of bytes
+        size_t size;
+    };
+
+    /**
+     * \brief Consumer side of a ring buffer filled by a circular DMA channel
+     *
+     * The write position is derived from the DMA's remaining-count register, and the amount of half-transfer and
+     * transfer-complete events, which have to be reported through on_half().
+     * This class doesn't touch any hardware itself, so it can be used on the host with a simulated register.
+     * Data is handed out without copying, as spans into the ring.
+     * When the consumer falls more than a whole buffer behind, the oldest data is dropped and an overflow is counted.
+     */
+    class slave_ring {
+        /// \brief Ring buffer the DMA writes into
+        const uint8_t *buffer;
+        /// \brief Size of the ring buffer, should be even
+        size_t size;
+        /// \brief DMA register containing the amount of transfers left until the buffer wraps (CNDTR)
+        const volatile uint32_t *remaining;
+        /// \brief Amount of half-transfer and transfer-complete events, updated from the DMA interrupt
+        volatile uint32_t halves = 0;
+        /// \brief Total amount of bytes consumed (wraps around)
+        uint32_t read = 0;
+        /// \brief Amount of times data was dropped because the consumer was too slow
+        uint32_t overflow_count = 0;
+
+    public:
+        /**
+         * \brief Create a ring
+         * @param buffer Ring buffer the DMA writes into
+         * @param size Size of the ring buffer, should be even
+         * @param remaining DMA register containing the amount of transfers left until the buffer wraps
+         */
+        slave_ring(const uint8_t *buffer, size_t size, const volatile uint32_t *remaining);
+
+        /**
+         * \brief Forget all data and counters, should be called when the DMA is (re)started
+         */
+        void reset();
+
+        /**
+         * \brief Report a half-transfer or transfer-complete event of the DMA
+         *
+         * Should be called from the DMA interrupt.
+         */
+        void on_half();
+
+        /**
+         * \brief Get the amount of bytes received but not consumed yet
+         */
+        size_t available();
+
+        /**
+         * \brief Get the oldest received data that isn't consumed yet
+         *
+         * Only returns data up to the end of the ring buffer, call again after consuming to get the data after the wrap.
+         * The data stays valid until it is consumed, as long as the consumer keeps up.
+         * @return Span pointing into the ring buffer, with size 0 when there is no data
+         */
+        slave_span peek();
+
+        /**
+         * \brief Mark data as consumed
+         * @param n Amount of bytes to consume, at most the size of the last peek()
+         */
+        void consume(size_t n);
+
+        /**
+         * \brief Get the amount of times data was dropped because the consumer was too slow
+         */
+        uint32_t overflows() const;
+
+    private:
+        /**
+         * \brief Get the total amount of bytes written by the DMA (wraps around)
+         */
+        uint32_t written() const;
+
+        /**
+         * \brief Drop data the DMA has overwritten, counting an overflow
+         * @param total_written Current result of written()
+         */
+        void check_overflow(uint32_t total_written);
+    };
+
+    /**
+     * @}
+     */
+}
+
+#endif //IPASS_SPI_SLAVE_RING_HPP
@@ -8,41 +8,42 @@
 */
 
 #include <spi/bus_base.hpp>
+#include <spi/bit_reverse.hpp>
 
 namespace spi {
     spi_base_bus::spi_transaction &
     spi_base_bus::spi_transaction::write_read_reverse(size_t n, const uint8_t *data_out, uint8_t *data_in) {
-        bus.write_read_reverse(n, data_out, data_in);
+        bus.transfer(n, data_out, data_in, true);
         return *this;
     }
 
     spi_base_bus::spi_transaction &
     spi_base_bus::spi_transaction::write(size_t n, const uint8_t *data_out) {
-        bus.write_read(n, data_out, nullptr);
+        bus.transfer(n, data_out, nullptr, false);
         return *this;
     }
 
     spi_base_bus::spi_transaction &
     spi_base_bus::spi_transaction::write_reverse(size_t n, const uint8_t *data_out) {
-        bus.write_read_reverse(n, data_out, nullptr);
+        bus.transfer(n, data_out, nullptr, true);
         return *this;
     }
 
     spi_base_bus::spi_transaction &
     spi_base_bus::spi_transaction::read(size_t n, uint8_t *data_in) {
-        bus.write_read(n, nullptr, data_in);
+        bus.transfer(n, nullptr, data_in, false);
         return *this;
     }
 
     spi_base_bus::spi_transaction &
     spi_base_bus::spi_transaction::read_reverse(size_t n, uint8_t *data_in) {
-        bus.write_read_reverse(n, nullptr, data_in);
+        bus.transfer(n, nullptr, data_in, true);
         return *this;
     }
 
     spi_base_bus::spi_transaction &
     spi_base_bus::spi_transaction::write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) {
-        bus.write_read(n, data_out, data_in);
+        bus.transfer(n, data_out, data_in, false);
         return *this;
     }
 
@@ -50,6 +51,11 @@ namespace spi {
         bus.onStart(*this);
     }
 
+    spi_base_bus::spi_transaction::spi_transaction(spi_base_bus &bus, const chip_select &csn)
+            : bus(bus), csn(hwlib::pin_out_dummy), fast_csn(&csn) {
+        bus.onStart(*this);
+    }
+
     spi_base_bus::spi_transaction::~spi_transaction() {
         bus.onEnd(*this);
     }
@@ -57,6 +63,7 @@ namespace spi {
     uint8_t spi_base_bus::spi_transaction::read_byte(const uint8_t *data_out) {
         uint8_t value[1];
         write_read(1, data_out, value);
+        bus.complete_reads();
         return *value;
     }
 
@@ -65,12 +72,31 @@ namespace spi {
         return write_read(1, &temp, data_in);
     }
 
+    spi_base_bus::spi_transaction &
+    spi_base_bus::spi_transaction::write_crc(size_t n, const uint8_t *data_out, crc_base &crc) {
+        bus.write_read_crc(n, data_out, nullptr, crc, false);
+        return *this;
+    }
+
+    bool spi_base_bus::spi_transaction::read_crc(size_t n, uint8_t *data_in, crc_base &crc) {
+        return bus.write_read_crc(n, nullptr, data_in, crc, true);
+    }
+
+    spi_base_bus::spi_transaction &spi_base_bus::spi_transaction::complete() {
+        bus.complete_reads();
+        return *this;
+    }
+
     spi_base_bus::spi_base_bus(const spi_mode mode) : mode(mode) {}
 
     spi_base_bus::spi_transaction spi_base_bus::transaction(hwlib::pin_out &csn) {
         return spi_base_bus::spi_transaction(*this, csn);
     }
 
+    spi_base_bus::spi_transaction spi_base_bus::transaction(const chip_select &csn) {
+        return spi_base_bus::spi_transaction(*this, csn);
+    }
+
     void spi_base_bus::write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) {
         uint8_t outbuffer[n];
         uint8_t inbuffer[n];
@@ -80,9 +106,10 @@ namespace spi {
             }
         }
 
-        write_read_reverse(n, outbuffer, inbuffer);
+        write_read_reverse(n, data_out != nullptr ? outbuffer : nullptr, data_in != nullptr ? inbuffer : nullptr);
 
         if (data_in != nullptr) {
+            complete_reads();
             for (size_t i = 0; i < n; i++) {
                 data_in[i] = inbuffer[n - 1 - i];
             }
@@ -98,26 +125,113 @@ namespace spi {
             }
         }
 
-        write_read(n, outbuffer, inbuffer);
+        write_read(n, data_out != nullptr ? outbuffer : nullptr, data_in != nullptr ? inbuffer : nullptr);
 
         if (data_in != nullptr) {
+            complete_reads();
             for (size_t i = 0; i < n; i++) {
                 data_in[i] = inbuffer[n - 1 - i];
             }
         }
     }
 
+    bool spi_base_bus::native_lsb_first() const {
+        return false;
+    }
+
+    void spi_base_bus::transfer(size_t n, const uint8_t *data_out, uint8_t *data_in, bool reverse) {
+        if (!mode.lsb_first || native_lsb_first()) {
+            if (reverse) {
+                write_read_reverse(n, data_out, data_in);
+            } else {
+                write_read(n, data_out, data_in);
+            }
+            return;
+        }
+
+        // Reversing the bits of a LSByte first transfer turns it into a plain MSByte first one
+        uint8_t outbuffer[n];
+        uint8_t inbuffer[n];
+        if (data_out != nullptr) {
+            if (reverse) {
+                reverse_bits_and_bytes(n, data_out, outbuffer);
+            } else {
+                reverse_bits(n, data_out, outbuffer);
+            }
+        }
+
+        write_read(n, data_out != nullptr ? outbuffer : nullptr, data_in != nullptr ? inbuffer : nullptr);
+
+        if (data_in != nullptr) {
+            complete_reads();
+            if (reverse) {
+                reverse_bits_and_bytes(n, inbuffer, data_in);
+            } else {
+                reverse_bits(n, inbuffer, data_in);
+            }
+        }
+    }
+
+    bool spi_base_bus::write_read_crc(size_t n, const uint8_t *data_out, uint8_t *data_in, crc_base &crc,
+                                      bool check) {
+        // Only ever read into, writing without data_out sends zeroes
+        uint8_t buffer[n];
+        if (check && data_in == nullptr) {
+            data_in = buffer;
+        }
+
+        transfer(n, data_out, data_in, false);
+        if (check) {
+            complete_reads();
+            crc.update(n, data_in);
+        } else if (data_out != nullptr) {
+            crc.update(n, data_out);
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                crc.update(uint8_t(0));
+            }
+        }
+
+        uint8_t expected[2];
+        uint8_t received[2];
+        crc.value_bytes(expected);
+        if (!check) {
+            transfer(crc.size(), expected, nullptr, false);
+            return true;
+        }
+        transfer(crc.size(), nullptr, received, false);
+        complete_reads();
+        for (size_t i = 0; i < crc.size(); i++) {
+            if (received[i] != expected[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void spi_base_bus::complete_reads() {}
+
     void spi_base_bus::onStart(spi::spi_base_bus::spi_transaction &transaction) {
-        transaction.csn.write(false);
+        if (transaction.fast_csn != nullptr) {
+            transaction.fast_csn->select();
+        } else {
+            transaction.csn.write(false);
+        }
     }
 
     void spi_base_bus::onEnd(spi::spi_base_bus::spi_transaction &transaction) {
-        transaction.csn.write(true);
+        if (transaction.fast_csn != nullptr) {
+            transaction.fast_csn->deselect();
+        } else {
+            transaction.csn.write(true);
+        }
     }
 
-    spi_mode::spi_mode(bool clockPolarity, bool clockPhase, uint32_t halfTimeNs) : clock_polarity(clockPolarity),
-                                                                                   clock_phase(clockPhase),
-                                                                                   half_time_ns(halfTimeNs) {}
+    spi_mode::spi_mode(bool clockPolarity, bool clockPhase, uint32_t halfTimeNs, bool lsbFirst)
+            : clock_polarity(clockPolarity),
+              clock_phase(clockPhase),
+              half_time_ns(halfTimeNs),
+              lsb_first(lsbFirst) {}
 
     spi_mode::spi_mode() = default;
 }
@@ -16,6 +16,32 @@ spi::bus_bitbang::bus_bitbang(hwlib::pin_out &_sclk, hwlib::pin_out &_mosi, hwli
           mosi(_mosi), miso(_miso) {
     sclk.write(mode.clock_polarity);
     mosi.write(false);
+    calibrate();
+}
+
+void spi::bus_bitbang::calibrate() {
+    if (mode.half_time_ns == 0) {
+        half_wait_ns = 0;
+        return;
+    }
+
+    // Same pin operations as a single bit, without waiting. SCLK is kept at its idle level, so no device sees a clock edge.
+    uint_fast64_t start = now_ns();
+    for (uint32_t i = 0; i < calibration_cycles; ++i) {
+        mosi.write(false);
+        sclk.write(mode.clock_polarity);
+        miso.read();
+        sclk.write(mode.clock_polarity);
+    }
+    uint_fast64_t overhead = (now_ns() - start) / (calibration_cycles * 2);
+
+    half_wait_ns = (overhead < mode.half_time_ns)
+                   ? static_cast<uint32_t>(mode.half_time_ns - overhead)
+                   : 0;
+}
+
+uint32_t spi::bus_bitbang::get_half_wait_ns() const {
+    return half_wait_ns;
 }
 
 
@@ -59,33 +85,114 @@ void spi::bus_bitbang::write_read_reverse(size_t n, const uint8_t *data_out, uin
     wait_half_period();
 }
 
+bool spi::bus_bitbang::write_read_crc(size_t n, const uint8_t *data_out, uint8_t *data_in, spi::crc_base &crc,
+                                      bool check) {
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t d =
+                (data_out == nullptr)
+                ? 0
+                : *data_out++;
+        uint8_t written = d;
+
+        write_read_byte(d);
+        crc.update(check ? d : written);
+
+        if (data_in != nullptr) {
+            *data_in++ = d;
+        }
+    }
+
+    uint8_t expected[2];
+    crc.value_bytes(expected);
+    bool match = true;
+    for (size_t i = 0; i < crc.size(); ++i) {
+        uint8_t d = check ? 0 : expected[i];
+        write_read_byte(d);
+        if (check && d != expected[i]) {
+            match = false;
+        }
+    }
+    wait_half_period();
+    return match;
+}
 
 void spi::bus_bitbang::wait_half_period() {
-    hwlib::wait_ns_busy(mode.half_time_ns);
+    if (half_wait_ns == 0) {
+        return;
+    }
+    if (delay_hooked) {
+        wait_half_period_timed<true>();
+    } else {
+        wait_half_period_timed<false>();
+    }
+}
+
+void spi::bus_bitbang::delay_ns(uint32_t ns) {
+    hwlib::wait_ns_busy(ns);
+}
+
+uint_fast64_t spi::bus_bitbang::now_ns() {
+    return hwlib::now_us() * 1000;
 }
 
 void spi::bus_bitbang::write_read_byte(uint8_t &d) {
+    if (half_wait_ns == 0) {
+        if (mode.lsb_first) {
+            write_read_byte_timed<false, true, false>(d);
+        } else {
+            write_read_byte_timed<false, false, false>(d);
+        }
+    } else if (delay_hooked) {
+        if (mode.lsb_first) {
+            write_read_byte_timed<true, true, true>(d);
+        } else {
+            write_read_byte_timed<true, false, true>(d);
+        }
+    } else {
+        if (mode.lsb_first) {
+            write_read_byte_timed<true, true, false>(d);
+        } else {
+            write_read_byte_timed<true, false, false>(d);
+        }
+    }
+}
+
+bool spi::bus_bitbang::native_lsb_first() const {
+    return true;
+}
+
+template<bool wait, bool lsb_first, bool hooked>
+void spi::bus_bitbang::write_read_byte_timed(uint8_t &d) {
+    constexpr uint8_t out_bit = lsb_first ? 0x01 : 0x80;
+    constexpr uint8_t in_bit = lsb_first ? 0x80 : 0x01;
+
     if (mode.clock_phase) {
         for (uint_fast8_t j = 0; j < 8; ++j) {
             sclk.write(!mode.clock_polarity);
-            mosi.write((d & 0x80) != 0);
-            wait_half_period();
-            wait_half_period();
+            mosi.write((d & out_bit) != 0);
+            if (wait) {
+                wait_half_period_timed<hooked>();
+                wait_half_period_timed<hooked>();
+            }
             sclk.write(mode.clock_polarity);
-            d = d << 1;
+            d = lsb_first ? d >> 1 : d << 1;
             if (miso.read()) {
-                d |= 0x01;
+                d |= in_bit;
             }
         }
     } else {
         for (uint_fast8_t j = 0; j < 8; ++j) {
-            mosi.write((d & 0x80) != 0);
-            wait_half_period();
+            mosi.write((d & out_bit) != 0);
+            if (wait) {
+                wait_half_period_timed<hooked>();
+            }
             sclk.write(!mode.clock_polarity);
-            wait_half_period();
-            d = d << 1;
+            if (wait) {
+                wait_half_period_timed<hooked>();
+            }
+            d = lsb_first ? d >> 1 : d << 1;
             if (miso.read()) {
-                d |= 0x01;
+                d |= in_bit;
             }
             sclk.write(mode.clock_polarity);
         }
@@ -0,0 +1,174 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include <spi/bus_shared.hpp>
+
+namespace spi {
+    bool bus_job::is_done() const {
+        return done.load(std::memory_order_acquire);
+    }
+
+    void bus_job::wait() const {
+        if (!is_done()) {
+            owner->wait_for(*this);
+        }
+    }
+
+    transfer_job::transfer_job(size_t n, const uint8_t *data_out, uint8_t *data_in) : n(n), data_out(data_out),
+                                                                                     data_in(data_in) {}
+
+    void transfer_job::execute(spi_base_bus::spi_transaction &transaction) {
+        transaction.write_read(n, data_out, data_in);
+    }
+
+    bus_shared::bus_shared(spi_base_bus &bus) : bus(bus), head(&stub), tail(&stub) {
+        worker = std::thread(&bus_shared::run, this);
+    }
+
+    bus_shared::~bus_shared() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping.store(true);
+        }
+        wakeup.notify_one();
+        worker.join();
+    }
+
+    void bus_shared::submit(bus_job &job, hwlib::pin_out &csn, bool merge) {
+        job.csn = &csn;
+        job.fast_csn = nullptr;
+        enqueue(job, merge);
+    }
+
+    void bus_shared::submit(bus_job &job, const chip_select &csn, bool merge) {
+        job.csn = nullptr;
+        job.fast_csn = &csn;
+        enqueue(job, merge);
+    }
+
+    void bus_shared::enqueue(bus_job &job, bool merge) {
+        job.owner = this;
+        job.merge = merge;
+        job.done.store(false, std::memory_order_relaxed);
+        push(&job);
+
+        // Pairs with the worker setting waiting before checking pending, so one of both always notices the other
+        pending.fetch_add(1);
+        if (waiting.load()) {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            wakeup.notify_one();
+        }
+    }
+
+    void bus_shared::wait_for(const bus_job &job) {
+        // Pairs with the worker storing done before checking done_waiters, so one of both always notices the other
+        done_waiters.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(done_mutex);
+            done_signal.wait(lock, [&job] { return job.done.load(); });
+        }
+        done_waiters.fetch_sub(1);
+    }
+
+    void bus_shared::push(bus_job_node *node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        bus_job_node *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    bus_job *bus_shared::pop() {
+        bus_job_node *first = tail;
+        bus_job_node *next = first->next.load(std::memory_order_acquire);
+
+        if (first == &stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            tail = next;
+            return static_cast<bus_job *>(first);
+        }
+
+        // first is the last node, a producer may be halfway linking a new one
+        if (first != head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        // Put the stub back behind the last node, so that node can be handed out
+        push(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail = next;
+            return static_cast<bus_job *>(first);
+        }
+        return nullptr;
+    }
+
+    void bus_shared::run() {
+        bus_job *job = nullptr;
+        bus_job *batch[max_batch];
+
+        for (;;) {
+            if (job == nullptr) {
+                job = pop();
+            }
+
+            if (job == nullptr) {
+                std::unique_lock<std::mutex> lock(sleep_mutex);
+                waiting.store(true);
+                wakeup.wait(lock, [this] { return pending.load() > 0 || stopping.load(); });
+                waiting.store(false);
+                if (pending.load() == 0 && stopping.load()) {
+                    return;
+                }
+                // pending can be raised before the job is fully linked, so keep polling until it shows up
+                lock.unlock();
+                job = pop();
+                if (job == nullptr) {
+                    std::this_thread::yield();
+                }
+                continue;
+            }
+
+            size_t count;
+            if (job->fast_csn != nullptr) {
+                auto transaction = bus.transaction(*job->fast_csn);
+                count = execute_batch(transaction, job, batch);
+            } else {
+                auto transaction = bus.transaction(*job->csn);
+                count = execute_batch(transaction, job, batch);
+            }
+
+            pending.fetch_sub(count);
+            for (size_t i = 0; i < count; i++) {
+                batch[i]->done.store(true);
+            }
+            if (done_waiters.load() > 0) {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                done_signal.notify_all();
+            }
+        }
+    }
+
+    size_t bus_shared::execute_batch(spi_base_bus::spi_transaction &transaction, bus_job *&job, bus_job **batch) {
+        size_t count = 0;
+        do {
+            job->execute(transaction);
+            batch[count++] = job;
+            job = pop();
+        } while (job != nullptr && count < max_batch && job->merge && job->csn == batch[0]->csn &&
+                 job->fast_csn == batch[0]->fast_csn);
+        return count;
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include <spi/hardware/bus_spidev.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace spi {
+    spidev_io_linux spidev_io_linux::instance;
+
+    int spidev_io_linux::open(const char *path) {
+        return ::open(path, O_RDWR);
+    }
+
+    void spidev_io_linux::close(int fd) {
+        ::close(fd);
+    }
+
+    int spidev_io_linux::ioctl(int fd, unsigned long request, void *arg) {
+        return ::ioctl(fd, request, arg);
+    }
+
+    bus_spidev::bus_spidev(const char *path, spi_mode mode, spidev_io &io) : spi_base_bus(mode), io(io) {
+        fd = io.open(path);
+        if (fd < 0) {
+            error = errno;
+            return;
+        }
+        configure();
+    }
+
+    bus_spidev::~bus_spidev() {
+        if (fd >= 0) {
+            io.close(fd);
+        }
+    }
+
+    void bus_spidev::set_mode(spi_mode new_mode) {
+        mode = new_mode;
+        configure();
+    }
+
+    int bus_spidev::get_error() const {
+        return error;
+    }
+
+    spi_base_bus::spi_transaction bus_spidev::transaction() {
+        return spi_base_bus::transaction(hwlib::pin_out_dummy);
+    }
+
+    void bus_spidev::write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) {
+        if (n == 0) {
+            return;
+        }
+
+        bool stage = data_out != nullptr && n <= staging_size;
+        if (segment_count == max_segments || (stage && staging_used + n > staging_size)) {
+            flush(true);
+        }
+
+        spi_ioc_transfer &segment = segments[segment_count++];
+        segment = {};
+        segment.len = n;
+        segment.speed_hz = speed_hz();
+        segment.bits_per_word = 8;
+        segment.rx_buf = (uintptr_t) data_in;
+        if (stage) {
+            memcpy(staging + staging_used, data_out, n);
+            segment.tx_buf = (uintptr_t) (staging + staging_used);
+            staging_used += n;
+        } else {
+            // Too big to copy, so it has to be sent before returning
+            segment.tx_buf = (uintptr_t) data_out;
+        }
+
+        if (data_out != nullptr && !stage) {
+            flush(true);
+        }
+    }
+
+    bool bus_spidev::native_lsb_first() const {
+        return true;
+    }
+
+    void bus_spidev::complete_reads() {
+        flush(true);
+    }
+
+    void bus_spidev::onStart(spi_base_bus::spi_transaction &) {}
+
+    void bus_spidev::onEnd(spi_base_bus::spi_transaction &) {
+        if (segment_count == 0 && selected) {
+            // CS was kept asserted by an earlier ioctl, release it with an empty segment
+            spi_ioc_transfer &segment = segments[segment_count++];
+            segment = {};
+            segment.speed_hz = speed_hz();
+            segment.bits_per_word = 8;
+        }
+        flush(false);
+    }
+
+    void bus_spidev::flush(bool keep_selected) {
+        if (segment_count == 0) {
+            return;
+        }
+        segments[segment_count - 1].cs_change = keep_selected ? 1 : 0;
+
+        if (fd >= 0 && io.ioctl(fd, SPI_IOC_MESSAGE(segment_count), segments) < 0) {
+            error = errno;
+        }
+
+        selected = keep_selected;
+        segment_count = 0;
+        staging_used = 0;
+    }
+
+    uint32_t bus_spidev::speed_hz() const {
+        if (mode.half_time_ns == 0) {
+            return 0;
+        }
+        return 500000000u / mode.half_time_ns;
+    }
+
+    void bus_spidev::configure() {
+        if (fd < 0) {
+            return;
+        }
+
+        uint8_t spi_mode_bits = (mode.clock_polarity ? SPI_CPOL : 0) | (mode.clock_phase ? SPI_CPHA : 0) |
+                                (mode.lsb_first ? SPI_LSB_FIRST : 0);
+        uint8_t bits = 8;
+        uint32_t speed = speed_hz();
+
+        if (io.ioctl(fd, SPI_IOC_WR_MODE, &spi_mode_bits) < 0 ||
+            io.ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+            (speed != 0 && io.ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0)) {
+            error = errno;
+        }
+    }
+}
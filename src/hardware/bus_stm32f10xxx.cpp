@@ -10,10 +10,15 @@
 #include <spi/hardware/bus_stm32f10xxx.hpp>
 
 namespace spi {
+    bus_stm32f10xxx *volatile bus_stm32f10xxx::streaming_bus = nullptr;
+
     void bus_stm32f10xxx::write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) {
 
         if (data_in != nullptr) {
+            // Reading DR and then SR clears a byte (and overrun) left over from a write-only transfer
             SPI1->DR;
+            SPI1->SR;
+            DMA1->IFCR = DMA_IFCR_CGIF2;
             DMA1_Channel2->CMAR = (uint32_t) data_in;
             DMA1_Channel2->CNDTR = n;
             DMA1_Channel2->CCR |= 1u;
@@ -24,10 +29,16 @@ namespace spi {
             DMA1_Channel3->CMAR = (uint32_t) data_out_empty;
         }
 
+        DMA1->IFCR = DMA_IFCR_CGIF3;
         DMA1_Channel3->CNDTR = n;
         DMA1_Channel3->CCR |= 1u;
 
-        while ((DMA1->ISR & DMA_ISR_TCIF2) == 0) {}
+        // Wait for the channel that was armed, the receive channel finishes last
+        if (data_in != nullptr) {
+            while ((DMA1->ISR & DMA_ISR_TCIF2) == 0) {}
+        } else {
+            while ((DMA1->ISR & DMA_ISR_TCIF3) == 0) {}
+        }
         while ((SPI1->SR & SPI_SR_TXE) == 0) {}
         while ((SPI1->SR & SPI_SR_BSY) > 0) {}
         DMA1_Channel2->CCR &= ~1u;
@@ -36,7 +47,24 @@ namespace spi {
     }
 
 
-    bus_stm32f10xxx::bus_stm32f10xxx(const spi::spi_mode mode) : spi_base_bus(mode) {
+    chip_select stm32_chip_select(GPIO_TypeDef *port, uint8_t pin, uint32_t setup_ns, uint32_t hold_ns) {
+        // The ports are 0x400 apart from GPIOA on, and so are their clock enable bits from IOPAEN on
+        uint32_t port_index = uint32_t(((uintptr_t) port - (uintptr_t) GPIOA) / 0x400u);
+        RCC->APB2ENR |= RCC_APB2ENR_IOPAEN << port_index;
+
+        uint32_t mask = 1u << pin;
+        port->BSRR = mask;
+
+        // General purpose push-pull output, 50MHz
+        volatile uint32_t &config = pin < 8 ? port->CRL : port->CRH;
+        uint32_t shift = (pin % 8u) * 4u;
+        config = (config & ~(0xFu << shift)) | (0x3u << shift);
+
+        return chip_select(&port->BRR, &port->BSRR, mask, setup_ns, hold_ns);
+    }
+
+    bus_stm32f10xxx::bus_stm32f10xxx(const spi::spi_mode mode, bool hardware_nss)
+            : spi_base_bus(mode), default_csn(&GPIOA->BRR, &GPIOA->BSRR, 1u << 4u), hardware_nss(hardware_nss) {
 
         RCC->APB2ENR |= RCC_APB2ENR_SPI1EN |
                         RCC_APB2ENR_IOPAEN | RCC_APB2ENR_IOPBEN |
@@ -45,8 +73,9 @@ namespace spi {
         RCC->AHBENR |= RCC_AHBENR_DMA1EN;
 
         GPIOA->CRL &= 0x0000FFFFu;
-        // NSSPin
-        GPIOA->CRL |= (0x3u << 16u);
+        // NSSPin, alternate function when driven by the peripheral
+        GPIOA->BSRR = 1u << 4u;
+        GPIOA->CRL |= hardware_nss ? (0xBu << 16u) : (0x3u << 16u);
         //Clock pin
         GPIOA->CRL |= (0xAu << 20u);
         //MISO pin
@@ -61,8 +90,12 @@ namespace spi {
 
         SPI1->I2SCFGR = 0;
 
-        SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_SPE | SPI_CR1_BR_1 | SPI_CR1_SSM | SPI_CR1_SSI;
-        SPI1->CR2 = SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN;
+        // LSBFIRST may only be changed while the peripheral is disabled, SPE is set once everything is configured.
+        // With hardware NSS, NSS goes low as soon as the peripheral is enabled, so that's postponed until a transaction starts
+        SPI1->CR1 = SPI_CR1_MSTR | SPI_CR1_BR_1 |
+                    (hardware_nss ? 0 : SPI_CR1_SSM | SPI_CR1_SSI) |
+                    (mode.lsb_first ? SPI_CR1_LSBFIRST : 0);
+        SPI1->CR2 = SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN | (hardware_nss ? SPI_CR2_SSOE : 0);
 
 
         //Configure DMA channel 1 rx
@@ -72,17 +105,183 @@ namespace spi {
         //Configure DMA channel 2 tx
         DMA1_Channel3->CCR = 0x0090;
         DMA1_Channel3->CPAR = (uint32_t) &(SPI1->DR);
+        if (!hardware_nss) {
+            SPI1->CR1 |= SPI_CR1_SPE;
+        }
+
+
+    }
+
+    bool bus_stm32f10xxx::write_read_crc(size_t n, const uint8_t *data_out, uint8_t *data_in, crc_base &crc,
+                                         bool check) {
+        // CRCEN can only be changed while the peripheral is disabled, which would release hardware NSS.
+        // With LSBFIRST the unit calculates over the reversed bitstream, which doesn't match the software CRC.
+        bool hardware_crc = !hardware_nss && !mode.lsb_first && crc.width == 8 && crc.xor_out == 0 && crc.end_bits == 0 &&
+                            crc.get_register() == 0 && n > 0 && (data_out != nullptr || n <= sizeof(data_out_empty)) &&
+                            (data_in != nullptr || !check);
+        if (!hardware_crc) {
+            return spi_base_bus::write_read_crc(n, data_out, data_in, crc, check);
+        }
+
+        SPI1->CR1 &= ~SPI_CR1_SPE;
+        SPI1->CRCPR = crc.polynomial;
+        SPI1->CR1 |= SPI_CR1_CRCEN;
         SPI1->CR1 |= SPI_CR1_SPE;
 
+        // With DMA, the peripheral sends and receives the CRC right after the last data byte by itself
+        write_read(n, data_out, data_in);
+        while ((SPI1->SR & SPI_SR_RXNE) == 0) {}
+        SPI1->DR;
 
+        bool match = (SPI1->SR & SPI_SR_CRCERR) == 0;
+        SPI1->SR = ~SPI_SR_CRCERR;
+        crc.set_register(uint16_t(check ? SPI1->RXCRCR : SPI1->TXCRCR));
+
+        SPI1->CR1 &= ~SPI_CR1_SPE;
+        SPI1->CR1 &= ~SPI_CR1_CRCEN;
+        SPI1->CR1 |= SPI_CR1_SPE;
+
+        return !check || match;
+    }
+
+    bool bus_stm32f10xxx::native_lsb_first() const {
+        return true;
     }
 
     void bus_stm32f10xxx::onStart(spi::spi_base_bus::spi_transaction &transaction) {
-        GPIOA->BSRR |= 1u << 20u;
+        if (transaction.fast_csn != nullptr && !hardware_nss) {
+            transaction.fast_csn->select();
+        } else if (&transaction.csn != &hwlib::pin_out_dummy && !hardware_nss) {
+            transaction.csn.write(false);
+        } else {
+            select_default();
+        }
     }
 
     void bus_stm32f10xxx::onEnd(spi::spi_base_bus::spi_transaction &transaction) {
-        GPIOA->BSRR |= 1u << 4u;
+        if (transaction.fast_csn != nullptr && !hardware_nss) {
+            transaction.fast_csn->deselect();
+        } else if (&transaction.csn != &hwlib::pin_out_dummy && !hardware_nss) {
+            transaction.csn.write(true);
+        } else {
+            deselect_default();
+        }
     }
-}
 
+    void bus_stm32f10xxx::select_default() {
+        if (hardware_nss) {
+            SPI1->CR1 |= SPI_CR1_SPE;
+        } else {
+            default_csn.select();
+        }
+    }
+
+    void bus_stm32f10xxx::deselect_default() {
+        if (hardware_nss) {
+            SPI1->CR1 &= ~SPI_CR1_SPE;
+        } else {
+            default_csn.deselect();
+        }
+    }
+
+    bool bus_stm32f10xxx::stream_start(size_t n, uint8_t *tx, uint8_t *rx, stream_handler &new_handler) {
+        // CNDTR is 16 bits, and the halves reported to the handler need an even size
+        if (n == 0 || n > 0xFFFFu || n % 2 != 0) {
+            return false;
+        }
+
+        stream_tx = tx;
+        stream_rx = rx;
+        stream_half_size = n / 2;
+        halves = 0;
+        overruns = 0;
+        handler = &new_handler;
+        streaming_bus = this;
+
+        DMA1_Channel2->CCR = 0;
+        DMA1_Channel3->CCR = 0;
+        DMA1->IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3;
+        SPI1->DR;
+
+        // Without a buffer, the memory address isn't incremented, so a single byte suffices
+        DMA1_Channel2->CMAR = (uint32_t) (rx != nullptr ? rx : &stream_rx_discard);
+        DMA1_Channel2->CNDTR = n;
+        DMA1_Channel2->CCR = DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE | (rx != nullptr ? DMA_CCR_MINC : 0);
+
+        DMA1_Channel3->CMAR = (uint32_t) (tx != nullptr ? tx : data_out_empty);
+        DMA1_Channel3->CNDTR = n;
+        DMA1_Channel3->CCR = DMA_CCR_DIR | DMA_CCR_CIRC | (tx != nullptr ? DMA_CCR_MINC : 0);
+
+        NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+        select_default();
+
+        DMA1_Channel2->CCR |= DMA_CCR_EN;
+        DMA1_Channel3->CCR |= DMA_CCR_EN;
+        return true;
+    }
+
+    void bus_stm32f10xxx::stream_stop() {
+        DMA1_Channel3->CCR &= ~DMA_CCR_EN;
+        while ((SPI1->SR & SPI_SR_TXE) == 0) {}
+        while ((SPI1->SR & SPI_SR_BSY) > 0) {}
+        DMA1_Channel2->CCR &= ~DMA_CCR_EN;
+        NVIC_DisableIRQ(DMA1_Channel2_IRQn);
+        deselect_default();
+
+        handler = nullptr;
+        streaming_bus = nullptr;
+
+        // Back to the transaction configuration
+        DMA1->IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3;
+        DMA1_Channel2->CCR = 0x0080;
+        DMA1_Channel3->CCR = 0x0090;
+        SPI1->DR;
+    }
+
+    uint32_t bus_stm32f10xxx::stream_halves() const {
+        return halves;
+    }
+
+    uint32_t bus_stm32f10xxx::stream_overruns() const {
+        return overruns;
+    }
+
+    void bus_stm32f10xxx::handle_dma_interrupt() {
+        bus_stm32f10xxx *bus = streaming_bus;
+        if (bus != nullptr) {
+            bus->stream_interrupt();
+        }
+    }
+
+    void bus_stm32f10xxx::stream_interrupt() {
+        uint32_t isr = DMA1->ISR;
+        DMA1->IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CHTIF2 | DMA_IFCR_CTCIF2;
+
+        bool half = (isr & DMA_ISR_HTIF2) != 0;
+        bool complete = (isr & DMA_ISR_TCIF2) != 0;
+        if (!(half || complete) || handler == nullptr) {
+            return;
+        }
+        if (half && complete) {
+            // Both events were pending, a whole half went by without being handled
+            overruns++;
+        }
+        if ((SPI1->SR & SPI_SR_OVR) != 0) {
+            SPI1->DR;
+            SPI1->SR;
+            overruns++;
+        }
+
+        size_t offset = complete ? stream_half_size : 0;
+        handler->stream_half(stream_tx != nullptr ? stream_tx + offset : nullptr,
+                             stream_rx != nullptr ? stream_rx + offset : nullptr,
+                             stream_half_size);
+        halves++;
+
+        // The DMA should still be in the other half, otherwise it already wrapped into the half that was being handled
+        bool dma_in_first_half = DMA1_Channel2->CNDTR > stream_half_size;
+        if (dma_in_first_half == (offset == 0)) {
+            overruns++;
+        }
+    }
+}
@@ -0,0 +1,15 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include <spi/hardware/bus_stm32f10xxx.hpp>
+
+// Only compiled when SPI_STREAM_IRQ=1, so applications can define this handler themselves otherwise
+extern "C" void DMA1_Channel2_IRQHandler() {
+    spi::bus_stm32f10xxx::handle_dma_interrupt();
+}
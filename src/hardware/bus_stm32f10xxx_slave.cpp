@@ -0,0 +1,186 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include <spi/hardware/bus_stm32f10xxx_slave.hpp>
+
+namespace spi {
+    bus_stm32f10xxx_slave *volatile bus_stm32f10xxx_slave::instance = nullptr;
+
+    bus_stm32f10xxx_slave::bus_stm32f10xxx_slave(uint8_t *buffer, size_t size, spi_mode mode, uint8_t idle_byte)
+            : ring(buffer, size, &DMA1_Channel4->CNDTR), idle_byte(idle_byte) {
+        instance = this;
+
+        RCC->APB1ENR |= RCC_APB1ENR_SPI2EN;
+        RCC->APB2ENR |= RCC_APB2ENR_IOPBEN | RCC_APB2ENR_AFIOEN;
+        RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+        GPIOB->CRH &= 0x0000FFFFu;
+        // NSS pin, input
+        GPIOB->CRH |= (0x4u << 16u);
+        // Clock pin, input
+        GPIOB->CRH |= (0x4u << 20u);
+        // MISO pin, alternate function push-pull
+        GPIOB->CRH |= (0xBu << 24u);
+        // MOSI pin, input
+        GPIOB->CRH |= (0x4u << 28u);
+
+        SPI2->CR1 = 0;
+        if (mode.clock_polarity) {
+            cr1_config |= SPI_CR1_CPOL;
+        }
+        if (mode.clock_phase) {
+            cr1_config |= SPI_CR1_CPHA;
+        }
+        if (mode.lsb_first) {
+            cr1_config |= SPI_CR1_LSBFIRST;
+        }
+
+        // Receive DMA, circular over the ring buffer
+        DMA1_Channel4->CCR = 0;
+        DMA1_Channel4->CPAR = (uint32_t) &(SPI2->DR);
+        DMA1_Channel4->CMAR = (uint32_t) buffer;
+        DMA1_Channel4->CNDTR = size;
+        DMA1->IFCR = DMA_IFCR_CGIF4 | DMA_IFCR_CGIF5;
+        DMA1_Channel4->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE;
+        ring.reset();
+
+        // Transmit DMA
+        DMA1_Channel5->CCR = 0;
+        DMA1_Channel5->CPAR = (uint32_t) &(SPI2->DR);
+
+        // Interrupt on NSS (B12) going high
+        AFIO->EXTICR[3] = (AFIO->EXTICR[3] & ~0xFu) | 0x1u;
+        EXTI->RTSR |= 1u << 12u;
+        EXTI->PR = 1u << 12u;
+        EXTI->IMR |= 1u << 12u;
+
+        NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+        NVIC_EnableIRQ(EXTI15_10_IRQn);
+
+        DMA1_Channel4->CCR |= DMA_CCR_EN;
+        load_response(nullptr, 0);
+        enable();
+    }
+
+    bus_stm32f10xxx_slave::~bus_stm32f10xxx_slave() {
+        NVIC_DisableIRQ(DMA1_Channel4_IRQn);
+        NVIC_DisableIRQ(EXTI15_10_IRQn);
+        EXTI->IMR &= ~(1u << 12u);
+        SPI2->CR1 &= ~SPI_CR1_SPE;
+        DMA1_Channel4->CCR = 0;
+        DMA1_Channel5->CCR = 0;
+        instance = nullptr;
+    }
+
+    slave_span bus_stm32f10xxx_slave::peek() {
+        return ring.peek();
+    }
+
+    void bus_stm32f10xxx_slave::consume(size_t n) {
+        ring.consume(n);
+    }
+
+    size_t bus_stm32f10xxx_slave::available() {
+        return ring.available();
+    }
+
+    void bus_stm32f10xxx_slave::queue_response(const uint8_t *data, size_t n) {
+        // Size first, the interrupt only looks at it once the pointer is set
+        next_response = nullptr;
+        next_response_size = n;
+        next_response = data;
+    }
+
+    uint32_t bus_stm32f10xxx_slave::overflows() const {
+        return ring.overflows();
+    }
+
+    uint32_t bus_stm32f10xxx_slave::frames() const {
+        return frame_count;
+    }
+
+    uint32_t bus_stm32f10xxx_slave::responses_missed() const {
+        return missed_responses;
+    }
+
+    void bus_stm32f10xxx_slave::handle_dma_interrupt() {
+        bus_stm32f10xxx_slave *bus = instance;
+        if (bus != nullptr) {
+            bus->dma_interrupt();
+        }
+    }
+
+    void bus_stm32f10xxx_slave::handle_nss_interrupt() {
+        if ((EXTI->PR & (1u << 12u)) == 0) {
+            return;
+        }
+        bus_stm32f10xxx_slave *bus = instance;
+        if (bus != nullptr) {
+            bus->nss_interrupt();
+        } else {
+            EXTI->PR = 1u << 12u;
+        }
+    }
+
+    void bus_stm32f10xxx_slave::dma_interrupt() {
+        uint32_t isr = DMA1->ISR;
+        DMA1->IFCR = DMA_IFCR_CGIF4 | DMA_IFCR_CHTIF4 | DMA_IFCR_CTCIF4;
+        if ((isr & DMA_ISR_HTIF4) != 0) {
+            ring.on_half();
+        }
+        if ((isr & DMA_ISR_TCIF4) != 0) {
+            ring.on_half();
+        }
+    }
+
+    void bus_stm32f10xxx_slave::nss_interrupt() {
+        EXTI->PR = 1u << 12u;
+        frame_count = frame_count + 1;
+
+        const uint8_t *data = next_response;
+        size_t n = next_response_size;
+        next_response = nullptr;
+        if (data == nullptr) {
+            missed_responses = missed_responses + 1;
+        }
+
+        // Let the receive DMA take the last byte of the frame
+        while ((SPI2->SR & SPI_SR_RXNE) != 0) {}
+
+        // The peripheral already holds a byte of the old response, and disabling it doesn't discard that on the F1.
+        // Resetting it does, so the new response starts at its first byte.
+        RCC->APB1RSTR |= RCC_APB1RSTR_SPI2RST;
+        RCC->APB1RSTR &= ~RCC_APB1RSTR_SPI2RST;
+        load_response(data, n);
+        enable();
+    }
+
+    void bus_stm32f10xxx_slave::enable() {
+        SPI2->CR1 = cr1_config;
+        SPI2->I2SCFGR = 0;
+        SPI2->CR2 = SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN;
+        SPI2->CR1 = cr1_config | SPI_CR1_SPE;
+    }
+
+    void bus_stm32f10xxx_slave::load_response(const uint8_t *data, size_t n) {
+        DMA1_Channel5->CCR = 0;
+        DMA1->IFCR = DMA_IFCR_CGIF5;
+        if (data != nullptr && n > 0) {
+            DMA1_Channel5->CMAR = (uint32_t) data;
+            DMA1_Channel5->CNDTR = n;
+            DMA1_Channel5->CCR = DMA_CCR_DIR | DMA_CCR_MINC;
+        } else {
+            // Repeat the idle byte for as long as the master keeps clocking
+            DMA1_Channel5->CMAR = (uint32_t) &idle_byte;
+            DMA1_Channel5->CNDTR = 1;
+            DMA1_Channel5->CCR = DMA_CCR_DIR | DMA_CCR_CIRC;
+        }
+        DMA1_Channel5->CCR |= DMA_CCR_EN;
+    }
+}
@@ -0,0 +1,19 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include <spi/hardware/bus_stm32f10xxx_slave.hpp>
+
+// Only compiled when SPI_SLAVE_IRQ=1, so applications can define these handlers themselves otherwise
+extern "C" void DMA1_Channel4_IRQHandler() {
+    spi::bus_stm32f10xxx_slave::handle_dma_interrupt();
+}
+
+extern "C" void EXTI15_10_IRQHandler() {
+    spi::bus_stm32f10xxx_slave::handle_nss_interrupt();
+}
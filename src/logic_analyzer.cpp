@@ -0,0 +1,184 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include <spi/logic_analyzer.hpp>
+
+namespace spi {
+    logic_analyzer::logic_analyzer(uint32_t pin_op_ns) : pin_op_ns(pin_op_ns) {}
+
+    uint_fast64_t logic_analyzer::now_ns() const {
+        return now;
+    }
+
+    void logic_analyzer::advance(uint32_t ns) {
+        now += ns;
+    }
+
+    void logic_analyzer::record(analyzer_channel channel, bool level) {
+        now += pin_op_ns;
+
+        auto index = static_cast<uint8_t>(channel);
+        if (seen[index] && levels[index] == level) {
+            return;
+        }
+        seen[index] = true;
+        levels[index] = level;
+
+        if (edge_count < max_edges) {
+            edges[edge_count++] = {now, channel, level};
+        } else {
+            dropped++;
+        }
+    }
+
+    bool logic_analyzer::level(analyzer_channel channel) const {
+        return levels[static_cast<uint8_t>(channel)];
+    }
+
+    void logic_analyzer::clear() {
+        edge_count = 0;
+        dropped = 0;
+        now = 0;
+        levels = {};
+        seen = {};
+    }
+
+    size_t logic_analyzer::get_edge_count() const {
+        return edge_count;
+    }
+
+    const logic_analyzer::edge &logic_analyzer::get_edge(size_t index) const {
+        return edges[index];
+    }
+
+    size_t logic_analyzer::get_dropped() const {
+        return dropped;
+    }
+
+    uint32_t logic_analyzer::measure_cycles(uint_fast64_t &period_total, uint_fast64_t &high_total) const {
+        uint32_t cycles = 0;
+        period_total = 0;
+        high_total = 0;
+
+        // CSN is assumed high (deselected) until it is recorded
+        bool selected = false;
+        bool have_rise = false;
+        bool have_fall = false;
+        uint_fast64_t last_rise = 0;
+        uint_fast64_t last_fall = 0;
+
+        for (size_t i = 0; i < edge_count; i++) {
+            const edge &e = edges[i];
+            if (e.channel == analyzer_channel::csn) {
+                selected = !e.level;
+                have_rise = false;
+                have_fall = false;
+            } else if (e.channel == analyzer_channel::sclk && selected) {
+                if (e.level) {
+                    if (have_rise && have_fall) {
+                        period_total += e.time_ns - last_rise;
+                        high_total += last_fall - last_rise;
+                        cycles++;
+                    }
+                    last_rise = e.time_ns;
+                    have_rise = true;
+                    have_fall = false;
+                } else if (have_rise) {
+                    last_fall = e.time_ns;
+                    have_fall = true;
+                }
+            }
+        }
+        return cycles;
+    }
+
+    uint32_t logic_analyzer::clock_cycles() const {
+        uint_fast64_t period_total, high_total;
+        return measure_cycles(period_total, high_total);
+    }
+
+    uint_fast64_t logic_analyzer::average_period_ns() const {
+        uint_fast64_t period_total, high_total;
+        uint32_t cycles = measure_cycles(period_total, high_total);
+        if (cycles == 0) {
+            return 0;
+        }
+        return period_total / cycles;
+    }
+
+    uint32_t logic_analyzer::bit_rate() const {
+        uint_fast64_t period_total, high_total;
+        uint32_t cycles = measure_cycles(period_total, high_total);
+        if (period_total == 0) {
+            return 0;
+        }
+        return static_cast<uint32_t>(cycles * uint_fast64_t(1000000000) / period_total);
+    }
+
+    uint8_t logic_analyzer::duty_cycle() const {
+        uint_fast64_t period_total, high_total;
+        measure_cycles(period_total, high_total);
+        if (period_total == 0) {
+            return 0;
+        }
+        return static_cast<uint8_t>(high_total * 100 / period_total);
+    }
+
+    uint_fast64_t logic_analyzer::wasted_ns_per_bit(const spi_mode &mode) const {
+        uint_fast64_t period = average_period_ns();
+        uint_fast64_t configured = uint_fast64_t(mode.half_time_ns) * 2;
+        return period > configured ? period - configured : 0;
+    }
+
+    analyzer_pin_out::analyzer_pin_out(logic_analyzer &analyzer, analyzer_channel channel) : analyzer(analyzer),
+                                                                                            channel(channel) {}
+
+    void analyzer_pin_out::write(bool v) {
+        analyzer.record(channel, v);
+    }
+
+    bool analyzer_pin_out::get() const {
+        return analyzer.level(channel);
+    }
+
+    analyzer_pin_in::analyzer_pin_in(logic_analyzer &analyzer, analyzer_channel channel) : analyzer(analyzer),
+                                                                                         channel(channel) {}
+
+    bool analyzer_pin_in::read() {
+        bool level = (source != nullptr) ? source->get() : value;
+        analyzer.record(channel, level);
+        return level;
+    }
+
+    void analyzer_pin_in::set(bool v) {
+        value = v;
+    }
+
+    void analyzer_pin_in::loopback(const analyzer_pin_out *pin) {
+        source = pin;
+    }
+
+    bus_bitbang_analyzed::bus_bitbang_analyzed(logic_analyzer &analyzer, analyzer_pin_out &_sclk,
+                                               analyzer_pin_out &_mosi, analyzer_pin_in &_miso,
+                                               const spi_mode &mode)
+            : bus_bitbang(_sclk, _mosi, _miso, mode), analyzer(analyzer) {
+        delay_hooked = true;
+        // The base constructor calibrated against the real clock
+        calibrate();
+        analyzer.clear();
+    }
+
+    void bus_bitbang_analyzed::delay_ns(uint32_t ns) {
+        analyzer.advance(ns);
+    }
+
+    uint_fast64_t bus_bitbang_analyzed::now_ns() {
+        return analyzer.now_ns();
+    }
+}
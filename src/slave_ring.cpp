@@ -0,0 +1,74 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#include <spi/slave_ring.hpp>
+
+namespace spi {
+    slave_ring::slave_ring(const uint8_t *buffer, size_t size, const volatile uint32_t *remaining)
+            : buffer(buffer), size(size), remaining(remaining) {}
+
+    void slave_ring::reset() {
+        halves = 0;
+        read = 0;
+        overflow_count = 0;
+    }
+
+    void slave_ring::on_half() {
+        halves = halves + 1;
+    }
+
+    uint32_t slave_ring::written() const {
+        uint32_t events;
+        uint32_t position;
+        // Retry when an event came in while reading the position
+        do {
+            events = halves;
+            position = uint32_t(size - *remaining) % size;
+        } while (events != halves);
+
+        uint32_t total = (events / 2) * size + position;
+
+        // The last event was a half-transfer, but the DMA is in the first half already: it wrapped, and the
+        // transfer-complete interrupt hasn't run yet
+        if ((events & 1u) != 0 && position < size / 2) {
+            total += size;
+        }
+        return total;
+    }
+
+    void slave_ring::check_overflow(uint32_t total_written) {
+        if (total_written - read > size) {
+            read = total_written - size;
+            overflow_count++;
+        }
+    }
+
+    size_t slave_ring::available() {
+        uint32_t total_written = written();
+        check_overflow(total_written);
+        return total_written - read;
+    }
+
+    slave_span slave_ring::peek() {
+        size_t n = available();
+        size_t start = read % size;
+        if (start + n > size) {
+            n = size - start;
+        }
+        return {buffer + start, n};
+    }
+
+    void slave_ring::consume(size_t n) {
+        read += n;
+    }
+
+    uint32_t slave_ring::overflows() const {
+        return overflow_count;
+    }
+}
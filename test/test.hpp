@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#ifndef IPASS_SPI_TEST_HPP
+#define IPASS_SPI_TEST_HPP
+
+#include <cstdio>
+
+namespace spi_test {
+    /// \brief Amount of failed checks
+    inline int failures = 0;
+
+    /// \brief Report a check, printing its location when it failed
+    inline void check(bool ok, const char *expression, const char *file, int line) {
+        if (!ok) {
+            std::printf("%s:%d: CHECK(%s) failed\n", file, line, expression);
+            failures++;
+        }
+    }
+
+    /// \brief Print a summary, and get the exit code of the test
+    inline int result(const char *name) {
+        if (failures == 0) {
+            std::printf("%s: passed\n", name);
+            return 0;
+        }
+        std::printf("%s: %d check(s) failed\n", name, failures);
+        return 1;
+    }
+}
+
+/// \brief Check an expression, continuing the test when it fails
+#define CHECK(expression) spi_test::check((expression), #expression, __FILE__, __LINE__)
+
+#endif //IPASS_SPI_TEST_HPP
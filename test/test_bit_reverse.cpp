@@ -0,0 +1,90 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/bit_reverse.hpp>
+#include "test.hpp"
+
+/// \brief Reference implementation, a bit at a time
+static uint8_t reverse_reference(uint8_t b) {
+    uint8_t r = 0;
+    for (int i = 0; i < 8; i++) {
+        if ((b & (1u << i)) != 0) {
+            r |= uint8_t(0x80u >> i);
+        }
+    }
+    return r;
+}
+
+static void test_table() {
+    bool all_match = true;
+    for (unsigned b = 0; b < 256; b++) {
+        all_match = all_match && spi::reverse_bits(uint8_t(b)) == reverse_reference(uint8_t(b));
+    }
+    CHECK(all_match);
+}
+
+static void test_buffers() {
+    uint8_t source[40];
+    for (size_t i = 0; i < sizeof(source); i++) {
+        source[i] = uint8_t(i * 37 + 11);
+    }
+
+    // Every size up to a few words, at every alignment, so both the word loop and the leftover bytes are used
+    bool bits_match = true;
+    bool bits_bytes_match = true;
+    bool in_place_match = true;
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t n = 0; n <= 19; n++) {
+            const uint8_t *in = source + offset;
+            uint8_t out[24 + 4] = {0};
+            uint8_t *out_unaligned = out + (3 - offset);
+
+            spi::reverse_bits(n, in, out_unaligned);
+            for (size_t i = 0; i < n; i++) {
+                bits_match = bits_match && out_unaligned[i] == reverse_reference(in[i]);
+            }
+
+            spi::reverse_bits_and_bytes(n, in, out_unaligned);
+            for (size_t i = 0; i < n; i++) {
+                bits_bytes_match = bits_bytes_match && out_unaligned[i] == reverse_reference(in[n - 1 - i]);
+            }
+
+            uint8_t copy[24];
+            for (size_t i = 0; i < n; i++) {
+                copy[i] = in[i];
+            }
+            spi::reverse_bits(n, copy, copy);
+            for (size_t i = 0; i < n; i++) {
+                in_place_match = in_place_match && copy[i] == reverse_reference(in[i]);
+            }
+        }
+    }
+    CHECK(bits_match);
+    CHECK(bits_bytes_match);
+    CHECK(in_place_match);
+}
+
+static void test_bounds() {
+    // Bytes around the reversed area stay untouched
+    const uint8_t in[7] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    uint8_t out[9] = {0xEE, 0, 0, 0, 0, 0, 0, 0, 0xEE};
+    spi::reverse_bits_and_bytes(7, in, out + 1);
+    CHECK(out[0] == 0xEE && out[8] == 0xEE);
+    CHECK(out[1] == 0xE0 && out[4] == 0x20 && out[7] == 0x80);
+}
+
+int main() {
+    test_table();
+    test_buffers();
+    test_bounds();
+    return spi_test::result("test_bit_reverse");
+}
@@ -0,0 +1,88 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/logic_analyzer.hpp>
+#include "test.hpp"
+
+/// \brief Amount of edges recorded on a channel
+static size_t edges_on(const spi::logic_analyzer &analyzer, spi::analyzer_channel channel) {
+    size_t count = 0;
+    for (size_t i = 0; i < analyzer.get_edge_count(); i++) {
+        if (analyzer.get_edge(i).channel == channel) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void test_calibration_is_silent() {
+    spi::logic_analyzer analyzer(50);
+    spi::analyzer_pin_out sclk(analyzer, spi::analyzer_channel::sclk);
+    spi::analyzer_pin_out mosi(analyzer, spi::analyzer_channel::mosi);
+    spi::analyzer_pin_in miso(analyzer, spi::analyzer_channel::miso);
+
+    // Only the initial levels are recorded, calibrating doesn't clock anything
+    spi::bus_bitbang bus(sclk, mosi, miso, spi::spi_mode(true, false, 1000));
+    CHECK(edges_on(analyzer, spi::analyzer_channel::sclk) == 1);
+    CHECK(edges_on(analyzer, spi::analyzer_channel::mosi) == 1);
+    CHECK(sclk.get());
+
+    bus.calibrate();
+    CHECK(edges_on(analyzer, spi::analyzer_channel::sclk) == 1);
+}
+
+static void test_rate_matches_mode(uint32_t half_time_ns, uint32_t pin_op_ns) {
+    spi::logic_analyzer analyzer(pin_op_ns);
+    spi::analyzer_pin_out sclk(analyzer, spi::analyzer_channel::sclk);
+    spi::analyzer_pin_out mosi(analyzer, spi::analyzer_channel::mosi);
+    spi::analyzer_pin_out csn(analyzer, spi::analyzer_channel::csn);
+    spi::analyzer_pin_in miso(analyzer, spi::analyzer_channel::miso);
+    spi::spi_mode mode(false, false, half_time_ns);
+    spi::bus_bitbang_analyzed bus(analyzer, sclk, mosi, miso, mode);
+
+    // Two pin operations per half period are measured, and subtracted from the wait
+    CHECK(bus.get_half_wait_ns() == half_time_ns - 2 * pin_op_ns);
+
+    const uint8_t data[4] = {0xA5, 0x5A, 0xFF, 0x00};
+    bus.transaction(csn).write(4, data);
+
+    CHECK(analyzer.get_dropped() == 0);
+    CHECK(analyzer.clock_cycles() == 31);
+    CHECK(analyzer.average_period_ns() == 2 * half_time_ns);
+    CHECK(analyzer.bit_rate() == 1000000000u / (2 * half_time_ns));
+    CHECK(analyzer.wasted_ns_per_bit(mode) == 0);
+    CHECK(analyzer.duty_cycle() == 50);
+}
+
+static void test_overhead_larger_than_period() {
+    spi::logic_analyzer analyzer(300);
+    spi::analyzer_pin_out sclk(analyzer, spi::analyzer_channel::sclk);
+    spi::analyzer_pin_out mosi(analyzer, spi::analyzer_channel::mosi);
+    spi::analyzer_pin_out csn(analyzer, spi::analyzer_channel::csn);
+    spi::analyzer_pin_in miso(analyzer, spi::analyzer_channel::miso);
+    spi::spi_mode mode(false, false, 500);
+    spi::bus_bitbang_analyzed bus(analyzer, sclk, mosi, miso, mode);
+
+    // The pins are too slow for the requested rate, so waiting is skipped and the difference shows up as waste
+    CHECK(bus.get_half_wait_ns() == 0);
+    bus.transaction(csn).write_byte(0x55);
+    CHECK(analyzer.average_period_ns() == 4 * 300);
+    CHECK(analyzer.wasted_ns_per_bit(mode) == 4 * 300 - 2 * 500);
+}
+
+int main() {
+    test_calibration_is_silent();
+    test_rate_matches_mode(1000, 100);
+    test_rate_matches_mode(250, 40);
+    test_overhead_larger_than_period();
+    return spi_test::result("test_bitbang_timing");
+}
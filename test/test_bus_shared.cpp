@@ -0,0 +1,160 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/bus_shared.hpp>
+#include <spi/bus_base.hpp>
+#include <chrono>
+#include <vector>
+#include "test.hpp"
+
+/**
+ * \brief Bus counting transactions and bytes, answering every byte with the byte written plus one
+ */
+class bus_counting : public spi::spi_base_bus {
+public:
+    size_t transactions = 0;
+    size_t bytes = 0;
+    size_t fast_selects = 0;
+
+    bus_counting() : spi_base_bus(spi::spi_mode()) {}
+
+protected:
+    void write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) override {
+        for (size_t i = 0; i < n; i++) {
+            uint8_t out = data_out != nullptr ? data_out[i] : 0;
+            if (data_in != nullptr) {
+                data_in[i] = uint8_t(out + 1);
+            }
+        }
+        bytes += n;
+    }
+
+    void onStart(spi_transaction &transaction) override {
+        transactions++;
+        if (transaction.fast_csn != nullptr) {
+            fast_selects++;
+        }
+        spi_base_bus::onStart(transaction);
+    }
+};
+
+/**
+ * \brief Job that keeps the worker busy until it is released
+ */
+class gate_job : public spi::bus_job {
+public:
+    std::atomic<bool> entered{false};
+    std::atomic<bool> released{false};
+
+protected:
+    void execute(spi::spi_base_bus::spi_transaction &) override {
+        entered.store(true);
+        while (!released.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+};
+
+static void test_many_producers() {
+    bus_counting bus;
+    constexpr size_t thread_count = 4;
+    constexpr size_t job_count = 250;
+    std::atomic<size_t> wrong{0};
+    {
+        spi::bus_shared shared(bus);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_count; t++) {
+            threads.emplace_back([&shared, &wrong, t] {
+                for (size_t i = 0; i < job_count; i++) {
+                    uint8_t out[2] = {uint8_t(t), uint8_t(i)};
+                    uint8_t in[2] = {0};
+                    spi::transfer_job job(2, out, in);
+                    shared.submit(job, hwlib::pin_out_dummy, true);
+                    job.wait();
+                    if (!job.is_done() || in[0] != uint8_t(t + 1) || in[1] != uint8_t(i + 1)) {
+                        wrong++;
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+    CHECK(wrong.load() == 0);
+    CHECK(bus.bytes == thread_count * job_count * 2);
+    CHECK(bus.transactions <= thread_count * job_count);
+}
+
+static void test_wait_blocks() {
+    bus_counting bus;
+    spi::bus_shared shared(bus);
+
+    gate_job gate;
+    shared.submit(gate, hwlib::pin_out_dummy);
+    while (!gate.entered.load()) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<bool> woke{false};
+    std::thread waiter([&gate, &woke] {
+        gate.wait();
+        woke.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!woke.load());
+    CHECK(!gate.is_done());
+
+    gate.released.store(true);
+    waiter.join();
+    CHECK(woke.load());
+    CHECK(gate.is_done());
+}
+
+static void test_chip_select() {
+    bus_counting bus;
+    volatile uint32_t select_register = 0;
+    volatile uint32_t deselect_register = 0;
+    spi::chip_select csn(&select_register, &deselect_register, 1u << 4u);
+    {
+        spi::bus_shared shared(bus);
+
+        // Keep the worker busy, so the jobs behind it are queued up
+        gate_job gate;
+        shared.submit(gate, csn);
+        while (!gate.entered.load()) {
+            std::this_thread::yield();
+        }
+
+        const uint8_t out = 0x10;
+        spi::transfer_job first(1, &out, nullptr);
+        spi::transfer_job second(1, &out, nullptr);
+        spi::transfer_job other_csn(1, &out, nullptr);
+        shared.submit(first, csn);
+        shared.submit(second, csn, true);
+        shared.submit(other_csn, hwlib::pin_out_dummy, true);
+        gate.released.store(true);
+        other_csn.wait();
+        CHECK(first.is_done() && second.is_done());
+    }
+    // gate, first + second merged, and other_csn which can't share a transaction with a different chip select
+    CHECK(bus.transactions == 3);
+    CHECK(bus.fast_selects == 2);
+    CHECK(select_register == (1u << 4u) && deselect_register == (1u << 4u));
+}
+
+int main() {
+    test_many_producers();
+    test_wait_blocks();
+    test_chip_select();
+    return spi_test::result("test_bus_shared");
+}
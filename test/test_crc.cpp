@@ -0,0 +1,178 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/crc.hpp>
+#include <spi/bus_testing.hpp>
+#include <spi/bit_reverse.hpp>
+#include <vector>
+#include "test.hpp"
+
+/**
+ * \brief Bus recording the bytes as they appear on the wire, using the base class for CRCs and bit order
+ */
+class bus_wire : public spi::spi_base_bus {
+public:
+    std::vector<uint8_t> mosi;
+    std::vector<uint8_t> miso;
+    size_t miso_index = 0;
+
+    explicit bus_wire(bool lsb_first) : spi_base_bus(spi::spi_mode(false, false, 1, lsb_first)) {}
+
+protected:
+    void write_read(size_t n, const uint8_t *data_out, uint8_t *data_in) override {
+        for (size_t i = 0; i < n; i++) {
+            mosi.push_back(data_out != nullptr ? data_out[i] : 0);
+            uint8_t in = miso_index < miso.size() ? miso[miso_index++] : 0xFF;
+            if (data_in != nullptr) {
+                data_in[i] = in;
+            }
+        }
+    }
+};
+
+static const uint8_t check_string[9] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+static const uint8_t cmd0[5] = {0x40, 0x00, 0x00, 0x00, 0x00};
+static const uint8_t cmd8[5] = {0x48, 0x00, 0x00, 0x01, 0xAA};
+
+static void test_check_values() {
+    spi::crc7_mmc crc7;
+    crc7.update(9, check_string);
+    CHECK(crc7.value() == 0x75);
+
+    spi::crc8_smbus crc8;
+    crc8.update(9, check_string);
+    CHECK(crc8.value() == 0xF4);
+
+    spi::crc16_xmodem xmodem;
+    xmodem.update(9, check_string);
+    CHECK(xmodem.value() == 0x31C3);
+
+    spi::crc16_ccitt_false ccitt;
+    ccitt.update(9, check_string);
+    CHECK(ccitt.value() == 0x29B1);
+
+    // Byte at a time gives the same result as the sliced update
+    ccitt.reset();
+    for (uint8_t byte : check_string) {
+        ccitt.update(byte);
+    }
+    CHECK(ccitt.value() == 0x29B1);
+    uint8_t bytes[2];
+    ccitt.value_bytes(bytes);
+    CHECK(bytes[0] == 0x29 && bytes[1] == 0xB1);
+}
+
+static void test_sd_commands() {
+    spi::crc7_mmc crc;
+    uint8_t byte;
+    crc.update(5, cmd0);
+    CHECK(crc.value() == 0x4A);
+    CHECK(crc.size() == 1);
+    crc.value_bytes(&byte);
+    CHECK(byte == 0x95);
+
+    crc.reset();
+    crc.update(5, cmd8);
+    crc.value_bytes(&byte);
+    CHECK(byte == 0x87);
+
+    spi::bus_testing bus;
+    crc.reset();
+    bus.transaction(hwlib::pin_out_dummy).write_crc(5, cmd0, crc);
+    CHECK(bus.match(std::array<uint8_t, 6>{0x40, 0x00, 0x00, 0x00, 0x00, 0x95}, true));
+}
+
+static void test_alignment() {
+    uint8_t bytes[2];
+
+    // CRC-4/INTERLAKEN, narrower than a byte: the top nibble
+    spi::crc<4, 0x3, 0xF, 0xF> crc4;
+    crc4.update(9, check_string);
+    CHECK(crc4.value() == 0xB);
+    CHECK(crc4.size() == 1);
+    crc4.value_bytes(bytes);
+    CHECK(bytes[0] == 0xB0);
+
+    // CRC-10/ATM, wider than a byte: the top 10 bits of two bytes
+    spi::crc<10, 0x233> crc10;
+    crc10.update(9, check_string);
+    CHECK(crc10.value() == 0x199);
+    CHECK(crc10.size() == 2);
+    crc10.value_bytes(bytes);
+    CHECK(bytes[0] == 0x66 && bytes[1] == 0x40);
+
+    // CRC-15/CAN with end bits in the one unused bit
+    spi::crc<15, 0x4599, 0, 0, 0x01> crc15;
+    crc15.update(9, check_string);
+    CHECK(crc15.value() == 0x059E);
+    crc15.value_bytes(bytes);
+    CHECK(bytes[0] == 0x0B && bytes[1] == 0x3D);
+
+    // Writing without data sends zeroes, and calculates over them
+    bus_wire bus(false);
+    spi::crc16_xmodem xmodem;
+    bus.transaction(hwlib::pin_out_dummy).write_crc(4, nullptr, xmodem);
+    spi::crc16_xmodem expected;
+    const uint8_t zeroes[4] = {0};
+    expected.update(4, zeroes);
+    expected.value_bytes(bytes);
+    CHECK(bus.mosi.size() == 6 && bus.mosi[0] == 0 && bus.mosi[4] == bytes[0] && bus.mosi[5] == bytes[1]);
+}
+
+static void test_read_check() {
+    spi::bus_testing bus;
+    spi::crc16_xmodem crc;
+    uint8_t data[9];
+
+    bus.append_in_buffer(std::array<uint8_t, 11>{'1', '2', '3', '4', '5', '6', '7', '8', '9', 0x31, 0xC3});
+    CHECK(bus.transaction(hwlib::pin_out_dummy).read_crc(9, data, crc));
+    CHECK(data[0] == '1' && data[8] == '9');
+
+    bus.clear();
+    crc.reset();
+    bus.append_in_buffer(std::array<uint8_t, 11>{'1', '2', '3', '4', '5', '6', '7', '8', '0', 0x31, 0xC3});
+    CHECK(!bus.transaction(hwlib::pin_out_dummy).read_crc(9, data, crc));
+}
+
+static void test_base_bus() {
+    // MSBit first, the software fallback of the base class
+    bus_wire msb(false);
+    spi::crc7_mmc crc;
+    msb.transaction(hwlib::pin_out_dummy).write_crc(5, cmd8, crc);
+    CHECK(msb.mosi.size() == 6 && msb.mosi[4] == 0xAA && msb.mosi[5] == 0x87);
+
+    // LSBit first, data and CRC both go through the bit reversal
+    bus_wire lsb(true);
+    spi::crc8_smbus crc8;
+    lsb.transaction(hwlib::pin_out_dummy).write_crc(9, check_string, crc8);
+    CHECK(lsb.mosi.size() == 10);
+    CHECK(lsb.mosi[0] == spi::reverse_bits('1') && lsb.mosi[9] == spi::reverse_bits(0xF4));
+
+    bus_wire lsb_in(true);
+    for (uint8_t byte : check_string) {
+        lsb_in.miso.push_back(spi::reverse_bits(byte));
+    }
+    lsb_in.miso.push_back(spi::reverse_bits(0xF4));
+    uint8_t data[9];
+    crc8.reset();
+    CHECK(lsb_in.transaction(hwlib::pin_out_dummy).read_crc(9, data, crc8));
+    CHECK(data[0] == '1' && data[8] == '9');
+}
+
+int main() {
+    test_check_values();
+    test_sd_commands();
+    test_alignment();
+    test_read_check();
+    test_base_bus();
+    return spi_test::result("test_crc");
+}
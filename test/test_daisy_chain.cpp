@@ -0,0 +1,97 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/daisy_chain.hpp>
+#include <spi/bus_testing.hpp>
+#include "test.hpp"
+
+/**
+ * \brief Chip select counting how often it is selected
+ */
+class counting_pin : public hwlib::pin_out {
+public:
+    size_t selects = 0;
+
+    void write(bool v) override {
+        if (!v) {
+            selects++;
+        }
+    }
+};
+
+static void test_coalescing() {
+    spi::bus_testing bus;
+    counting_pin latch;
+    spi::daisy_chain<3, 2> chain(bus, latch);
+
+    // The chain starts dirty, so the first flush always transfers
+    CHECK(chain.is_dirty());
+    CHECK(chain.flush());
+    CHECK(latch.selects == 1);
+    CHECK(!chain.flush());
+    CHECK(latch.selects == 1);
+    bus.clear();
+
+    const uint8_t first[2] = {0x12, 0x34};
+    const uint8_t last[2] = {0xAB, 0xCD};
+    chain.set(0, first);
+    chain.set(2, last);
+    chain.set_bit(1, 0, true);
+    chain.set_bit(1, 15, true);
+    CHECK(chain.get_updates() == 4);
+    CHECK(chain.is_dirty());
+
+    // Four changes, one transfer: device 2 (furthest from MOSI) is shifted first, every device MSByte first
+    CHECK(chain.flush());
+    CHECK(latch.selects == 2);
+    CHECK(chain.get_flushes() == 2);
+    CHECK(bus.out_buffer_size == 6);
+    CHECK(bus.match(std::array<uint8_t, 6>{0xAB, 0xCD, 0x80, 0x01, 0x12, 0x34}, true));
+    CHECK(!chain.is_dirty());
+
+    // Setting the same values again isn't a change
+    chain.set(0, first);
+    chain.set_bit(1, 15, true);
+    CHECK(chain.get_updates() == 4);
+    CHECK(!chain.flush());
+    CHECK(latch.selects == 2);
+
+    CHECK(chain.get(1)[0] == 0x80 && chain.get(1)[1] == 0x01);
+    chain.set_bit(1, 15, false);
+    CHECK(chain.get(1)[0] == 0x00);
+    CHECK(chain.is_dirty());
+}
+
+static void test_input_image() {
+    spi::bus_testing bus;
+    counting_pin latch;
+    spi::daisy_chain<2> chain(bus, latch);
+
+    // Shifted out of the chain in the same order as shifting in: the device furthest from MOSI comes first
+    bus.append_in_buffer(std::array<uint8_t, 2>{0x5A, 0xC3});
+    chain.refresh();
+    CHECK(*chain.get_input(1) == 0x5A);
+    CHECK(*chain.get_input(0) == 0xC3);
+
+    // refresh() transfers even when nothing changed
+    bus.append_in_buffer(std::array<uint8_t, 2>{0x01, 0x02});
+    CHECK(!chain.is_dirty());
+    chain.refresh();
+    CHECK(latch.selects == 2);
+    CHECK(*chain.get_input(1) == 0x01 && *chain.get_input(0) == 0x02);
+}
+
+int main() {
+    test_coalescing();
+    test_input_image();
+    return spi_test::result("test_daisy_chain");
+}
@@ -0,0 +1,139 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/flash_cache.hpp>
+#include <spi/bus_testing_flash.hpp>
+#include "test.hpp"
+
+/// \brief Fill the flash model with a known pattern
+static void fill_pattern(spi::bus_testing_flash<> &flash) {
+    for (size_t i = 0; i < flash.memory.size(); i++) {
+        flash.memory[i] = uint8_t(i * 7 + 3);
+    }
+}
+
+/// \brief Check a buffer against the pattern
+static bool matches_pattern(uint32_t address, size_t n, const uint8_t *data) {
+    for (size_t i = 0; i < n; i++) {
+        if (data[i] != uint8_t((address + i) * 7 + 3)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_hits_and_misses() {
+    spi::bus_testing_flash<> flash;
+    fill_pattern(flash);
+    spi::flash_cache<32, 8> cache(flash, hwlib::pin_out_dummy);
+
+    uint8_t data[16];
+    cache.read(100, 16, data);
+    CHECK(matches_pattern(100, 16, data));
+    CHECK(cache.get_misses() == 1);
+    CHECK(cache.get_hits() == 0);
+
+    cache.read(96, 16, data);
+    CHECK(matches_pattern(96, 16, data));
+    CHECK(cache.get_misses() == 1);
+    CHECK(cache.get_hits() == 1);
+    CHECK(flash.read_commands == 1);
+
+    // Spans two lines: the second one is a sequential miss
+    cache.read(120, 16, data);
+    CHECK(matches_pattern(120, 16, data));
+    CHECK(cache.get_hits() == 2);
+    CHECK(cache.get_misses() == 2);
+}
+
+static void test_sequential_readahead() {
+    spi::bus_testing_flash<> flash;
+    fill_pattern(flash);
+    spi::flash_cache<32, 8> cache(flash, hwlib::pin_out_dummy);
+
+    // 12 consecutive lines: from the second miss on, every miss also reads the next line
+    uint8_t line[32];
+    bool all_match = true;
+    for (uint32_t i = 0; i < 12; i++) {
+        cache.read(i * 32, 32, line);
+        all_match = all_match && matches_pattern(i * 32, 32, line);
+    }
+    CHECK(all_match);
+    CHECK(cache.get_misses() == 7);
+    CHECK(cache.get_readaheads() == 6);
+    CHECK(cache.get_hits() == 5);
+    CHECK(flash.transactions == 7);
+}
+
+static void test_lru_eviction() {
+    spi::bus_testing_flash<> flash;
+    fill_pattern(flash);
+    spi::flash_cache<32, 2> cache(flash, hwlib::pin_out_dummy);
+
+    // Non-sequential accesses, so no readahead
+    uint8_t data[1];
+    cache.read(0, 1, data);
+    cache.read(256, 1, data);
+    cache.read(0, 1, data);
+    cache.read(512, 1, data);
+    CHECK(cache.get_readaheads() == 0);
+    CHECK(cache.get_misses() == 3);
+
+    // 256 was least recently used, so it was evicted
+    cache.read(0, 1, data);
+    CHECK(cache.get_hits() == 2);
+    cache.read(256, 1, data);
+    CHECK(cache.get_misses() == 4);
+}
+
+static void test_write_invalidates() {
+    spi::bus_testing_flash<> flash;
+    spi::flash_cache<32, 8> cache(flash, hwlib::pin_out_dummy);
+
+    uint8_t data[40];
+    cache.read(0, 1, data);
+    cache.read(250, 40, data);
+    CHECK(data[0] == 0xFF);
+
+    // Crosses a page boundary, so it takes two page programs
+    uint8_t written[40];
+    for (uint8_t i = 0; i < 40; i++) {
+        written[i] = i;
+    }
+    cache.write(250, 40, written);
+    CHECK(flash.program_commands == 2);
+    CHECK(flash.memory[250] == 0 && flash.memory[289] == 39);
+
+    cache.clear_counters();
+    cache.read(250, 40, data);
+    CHECK(cache.get_misses() == 2);
+    CHECK(cache.get_readaheads() == 1);
+    bool all_match = true;
+    for (uint8_t i = 0; i < 40; i++) {
+        all_match = all_match && data[i] == i;
+    }
+    CHECK(all_match);
+
+    // Lines outside the written area stay cached
+    cache.clear_counters();
+    cache.read(0, 1, data);
+    CHECK(cache.get_hits() == 1);
+    CHECK(cache.get_misses() == 0);
+}
+
+int main() {
+    test_hits_and_misses();
+    test_sequential_readahead();
+    test_lru_eviction();
+    test_write_invalidates();
+    return spi_test::result("test_flash_cache");
+}
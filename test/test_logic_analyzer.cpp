@@ -0,0 +1,135 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/logic_analyzer.hpp>
+#include <sstream>
+#include <string>
+#include "test.hpp"
+
+static const char vcd_header[] =
+        "$timescale 1ns $end\n"
+        "$scope module spi $end\n"
+        "$var wire 1 ! sclk $end\n"
+        "$var wire 1 \" mosi $end\n"
+        "$var wire 1 # miso $end\n"
+        "$var wire 1 $ csn $end\n"
+        "$upscope $end\n"
+        "$enddefinitions $end\n"
+        "#0\n$dumpvars\nx!\nx\"\nx#\nx$\n$end\n";
+
+static void test_known_recording() {
+    spi::logic_analyzer analyzer(10);
+    spi::analyzer_pin_out sclk(analyzer, spi::analyzer_channel::sclk);
+    spi::analyzer_pin_out csn(analyzer, spi::analyzer_channel::csn);
+
+    // Every pin operation costs 10ns, repeated levels aren't edges
+    csn.write(true);
+    csn.write(false);
+    analyzer.advance(100);
+    sclk.write(true);
+    sclk.write(true);
+    analyzer.advance(50);
+    sclk.write(false);
+    analyzer.advance(90);
+    sclk.write(true);
+    analyzer.advance(60);
+    sclk.write(false);
+    analyzer.advance(130);
+    sclk.write(true);
+    csn.write(true);
+
+    CHECK(analyzer.now_ns() == 520);
+    CHECK(analyzer.get_edge_count() == 8);
+
+    std::ostringstream vcd;
+    analyzer.write_vcd(vcd);
+    CHECK(vcd.str() == std::string(vcd_header) +
+                       "#10\n1$\n#20\n0$\n#130\n1!\n#200\n0!\n#300\n1!\n#370\n0!\n#510\n1!\n#520\n1$\n");
+
+    // Rising edges at 130, 300 and 510: periods of 170 and 210, both 70 high
+    CHECK(analyzer.clock_cycles() == 2);
+    CHECK(analyzer.average_period_ns() == 190);
+    CHECK(analyzer.bit_rate() == 5263157);
+    CHECK(analyzer.duty_cycle() == 36);
+    CHECK(analyzer.wasted_ns_per_bit(spi::spi_mode(false, false, 80)) == 30);
+    CHECK(analyzer.wasted_ns_per_bit(spi::spi_mode(false, false, 100)) == 0);
+
+    analyzer.clear();
+    CHECK(analyzer.now_ns() == 0 && analyzer.get_edge_count() == 0);
+    CHECK(analyzer.bit_rate() == 0 && analyzer.duty_cycle() == 0);
+}
+
+static void test_shared_timestamps_and_overflow() {
+    spi::logic_analyzer analyzer;
+    spi::analyzer_pin_out sclk(analyzer, spi::analyzer_channel::sclk);
+    spi::analyzer_pin_out mosi(analyzer, spi::analyzer_channel::mosi);
+
+    // Without a pin cost, edges at the same time share a timestamp
+    sclk.write(false);
+    mosi.write(true);
+    analyzer.advance(5);
+    sclk.write(true);
+
+    std::ostringstream vcd;
+    analyzer.write_vcd(vcd);
+    CHECK(vcd.str() == std::string(vcd_header) + "#0\n0!\n1\"\n#5\n1!\n");
+
+    // Clocks outside of CSN low aren't measured
+    CHECK(analyzer.clock_cycles() == 0);
+
+    // SCLK is high already, so the first write isn't an edge: 3 + 4095 edges, 2 too many
+    for (size_t i = 0; i < spi::logic_analyzer::max_edges; i++) {
+        sclk.write(i % 2 == 0);
+    }
+    CHECK(analyzer.get_edge_count() == spi::logic_analyzer::max_edges);
+    CHECK(analyzer.get_dropped() == 2);
+}
+
+static void test_bitbang_transfer() {
+    spi::logic_analyzer analyzer(20);
+    spi::analyzer_pin_out sclk(analyzer, spi::analyzer_channel::sclk);
+    spi::analyzer_pin_out mosi(analyzer, spi::analyzer_channel::mosi);
+    spi::analyzer_pin_out csn(analyzer, spi::analyzer_channel::csn);
+    spi::analyzer_pin_in miso(analyzer, spi::analyzer_channel::miso);
+    miso.loopback(&mosi);
+    spi::bus_bitbang_analyzed bus(analyzer, sclk, mosi, miso, spi::spi_mode(false, false, 500));
+
+    uint8_t in = 0;
+    bus.transaction(csn).write_byte(0xA5, &in);
+    CHECK(in == 0xA5);
+
+    // Sample MOSI at every rising SCLK edge, like a device in mode 0 would
+    uint8_t sampled = 0;
+    size_t bits = 0;
+    bool mosi_level = false;
+    for (size_t i = 0; i < analyzer.get_edge_count(); i++) {
+        const spi::logic_analyzer::edge &e = analyzer.get_edge(i);
+        if (e.channel == spi::analyzer_channel::mosi) {
+            mosi_level = e.level;
+        } else if (e.channel == spi::analyzer_channel::sclk && e.level) {
+            sampled = uint8_t((sampled << 1u) | (mosi_level ? 1u : 0u));
+            bits++;
+        }
+    }
+    CHECK(bits == 8);
+    CHECK(sampled == 0xA5);
+    CHECK(analyzer.clock_cycles() == 7);
+    CHECK(analyzer.bit_rate() == 1000000);
+    CHECK(analyzer.duty_cycle() == 50);
+}
+
+int main() {
+    test_known_recording();
+    test_shared_timestamps_and_overflow();
+    test_bitbang_transfer();
+    return spi_test::result("test_logic_analyzer");
+}
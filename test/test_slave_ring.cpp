@@ -0,0 +1,158 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/slave_ring.hpp>
+#include "test.hpp"
+
+/**
+ * \brief Simulated circular DMA channel, writing into a ring buffer and counting down CNDTR
+ */
+template<size_t size>
+struct dma_simulation {
+    uint8_t buffer[size] = {0};
+    volatile uint32_t cndtr = size;
+    spi::slave_ring ring{buffer, size, &cndtr};
+    /// \brief Half-transfer and transfer-complete events whose interrupt hasn't run yet
+    uint32_t pending_events = 0;
+    /// \brief Value of the next byte received
+    uint8_t next_value = 0;
+
+    /// \brief Receive bytes, delivering the interrupts right away unless told otherwise
+    void receive(size_t n, bool deliver = true) {
+        for (size_t i = 0; i < n; i++) {
+            size_t position = size - cndtr;
+            buffer[position] = next_value++;
+            position++;
+            if (position == size / 2) {
+                pending_events++;
+            }
+            if (position == size) {
+                pending_events++;
+                position = 0;
+            }
+            cndtr = uint32_t(size - position);
+        }
+        if (deliver) {
+            interrupt();
+        }
+    }
+
+    /// \brief Run the DMA interrupt for all pending events
+    void interrupt() {
+        for (; pending_events > 0; pending_events--) {
+            ring.on_half();
+        }
+    }
+};
+
+static void test_receive_and_consume() {
+    dma_simulation<8> dma;
+    dma.ring.reset();
+    CHECK(dma.ring.available() == 0);
+    CHECK(dma.ring.peek().size == 0);
+
+    dma.receive(3);
+    CHECK(dma.ring.available() == 3);
+    spi::slave_span span = dma.ring.peek();
+    CHECK(span.data == dma.buffer && span.size == 3);
+    CHECK(span.data[0] == 0 && span.data[2] == 2);
+    dma.ring.consume(2);
+    CHECK(dma.ring.available() == 1);
+    CHECK(dma.ring.peek().data[0] == 2);
+}
+
+static void test_wrap_and_peek_split() {
+    dma_simulation<8> dma;
+    dma.ring.reset();
+
+    dma.receive(6);
+    dma.ring.consume(dma.ring.peek().size);
+
+    // Crosses the end of the buffer
+    dma.receive(4);
+    CHECK(dma.ring.available() == 4);
+    spi::slave_span first = dma.ring.peek();
+    CHECK(first.data == dma.buffer + 6 && first.size == 2);
+    CHECK(first.data[0] == 6 && first.data[1] == 7);
+    dma.ring.consume(first.size);
+
+    spi::slave_span second = dma.ring.peek();
+    CHECK(second.data == dma.buffer && second.size == 2);
+    CHECK(second.data[0] == 8 && second.data[1] == 9);
+    dma.ring.consume(second.size);
+    CHECK(dma.ring.available() == 0);
+
+    // Many wraps later, the count still holds
+    for (int i = 0; i < 20; i++) {
+        dma.receive(5);
+        CHECK(dma.ring.available() == 5);
+        while (dma.ring.available() > 0) {
+            dma.ring.consume(dma.ring.peek().size);
+        }
+    }
+    CHECK(dma.ring.overflows() == 0);
+}
+
+static void test_pending_transfer_complete() {
+    dma_simulation<8> dma;
+    dma.ring.reset();
+
+    // The half-transfer interrupt ran, the DMA wrapped, but the transfer-complete interrupt hasn't run yet
+    dma.receive(4);
+    dma.ring.consume(dma.ring.peek().size);
+    dma.receive(6, false);
+    CHECK(dma.pending_events == 1);
+    CHECK(dma.ring.available() == 6);
+
+    dma.interrupt();
+    CHECK(dma.ring.available() == 6);
+
+    // Past the half again, with the half-transfer interrupt pending: the count comes from the position
+    dma.ring.consume(dma.ring.peek().size);
+    dma.ring.consume(dma.ring.peek().size);
+    dma.receive(3, false);
+    CHECK(dma.pending_events == 1);
+    CHECK(dma.ring.available() == 3);
+    dma.interrupt();
+    CHECK(dma.ring.available() == 3);
+    CHECK(dma.ring.overflows() == 0);
+}
+
+static void test_overflow() {
+    dma_simulation<8> dma;
+    dma.ring.reset();
+
+    dma.receive(11);
+    CHECK(dma.ring.available() == 8);
+    CHECK(dma.ring.overflows() == 1);
+
+    // The oldest data left is byte 3, the bytes before it were overwritten
+    spi::slave_span span = dma.ring.peek();
+    CHECK(span.data == dma.buffer + 3 && span.size == 5);
+    CHECK(span.data[0] == 3);
+    dma.ring.consume(span.size);
+    span = dma.ring.peek();
+    CHECK(span.data == dma.buffer && span.size == 3 && span.data[0] == 8);
+    dma.ring.consume(span.size);
+    CHECK(dma.ring.overflows() == 1);
+
+    dma.ring.reset();
+    CHECK(dma.ring.overflows() == 0);
+}
+
+int main() {
+    test_receive_and_consume();
+    test_wrap_and_peek_split();
+    test_pending_transfer_complete();
+    test_overflow();
+    return spi_test::result("test_slave_ring");
+}
@@ -0,0 +1,185 @@
+/*
+ *
+ * Copyright Niels Post 2019.
+ * Distributed under the Boost Software License, Version 1.0.
+ * (See accompanying file LICENSE_1_0.txt or copy at
+ * https://www.boost.org/LICENSE_1_0.txt)
+ *
+*/
+
+#define HWLIB_ONCE
+
+#include <hwlib.hpp>
+#include <spi/hardware/bus_spidev.hpp>
+#include <cerrno>
+#include <vector>
+#include "test.hpp"
+
+/**
+ * \brief In-process spidev, records every message and answers every byte with the byte written plus one
+ */
+class spidev_io_fake : public spi::spidev_io {
+public:
+    /// \brief A single SPI_IOC_MESSAGE ioctl
+    struct message {
+        std::vector<spi_ioc_transfer> segments;
+    };
+
+    bool fail_open = false;
+    int opened = 0;
+    int closed = 0;
+    uint8_t mode_bits = 0;
+    uint32_t speed = 0;
+    std::vector<message> messages;
+    /// \brief Everything written through messages, in order
+    std::vector<uint8_t> written;
+
+    int open(const char *) override {
+        if (fail_open) {
+            errno = ENOENT;
+            return -1;
+        }
+        opened++;
+        return 3;
+    }
+
+    void close(int) override {
+        closed++;
+    }
+
+    int ioctl(int, unsigned long request, void *arg) override {
+        if (request == SPI_IOC_WR_MODE) {
+            mode_bits = *static_cast<uint8_t *>(arg);
+            return 0;
+        }
+        if (request == SPI_IOC_WR_MAX_SPEED_HZ) {
+            speed = *static_cast<uint32_t *>(arg);
+            return 0;
+        }
+        if (request == SPI_IOC_WR_BITS_PER_WORD) {
+            return 0;
+        }
+
+        size_t count = _IOC_SIZE(request) / sizeof(spi_ioc_transfer);
+        auto *segments = static_cast<spi_ioc_transfer *>(arg);
+        message m;
+        for (size_t i = 0; i < count; i++) {
+            const spi_ioc_transfer &segment = segments[i];
+            m.segments.push_back(segment);
+            auto *tx = (const uint8_t *) (uintptr_t) segment.tx_buf;
+            auto *rx = (uint8_t *) (uintptr_t) segment.rx_buf;
+            for (size_t j = 0; j < segment.len; j++) {
+                uint8_t out = tx != nullptr ? tx[j] : 0;
+                written.push_back(out);
+                if (rx != nullptr) {
+                    rx[j] = uint8_t(out + 1);
+                }
+            }
+        }
+        messages.push_back(m);
+        return int(count);
+    }
+};
+
+static void test_configure() {
+    spidev_io_fake io;
+    {
+        spi::bus_spidev bus("/dev/spidev0.0", spi::spi_mode(true, true, 500, true), io);
+        CHECK(bus.get_error() == 0);
+        CHECK(io.opened == 1);
+        CHECK(io.mode_bits == (SPI_CPOL | SPI_CPHA | SPI_LSB_FIRST));
+        CHECK(io.speed == 1000000);
+    }
+    CHECK(io.closed == 1);
+
+    spidev_io_fake missing;
+    missing.fail_open = true;
+    spi::bus_spidev bus("/dev/spidev9.9", spi::spi_mode(), missing);
+    CHECK(bus.get_error() == ENOENT);
+    bus.transaction().write_byte(0x9F);
+    CHECK(missing.messages.empty());
+}
+
+static void test_command_and_read_is_one_ioctl() {
+    spidev_io_fake io;
+    spi::bus_spidev bus("/dev/spidev0.0", spi::spi_mode(), io);
+
+    const uint8_t header[4] = {0x03, 0x00, 0x01, 0x00};
+    uint8_t data[8] = {0};
+    bus.transaction().write(4, header).read(8, data);
+
+    CHECK(io.messages.size() == 1);
+    const auto &segments = io.messages[0].segments;
+    CHECK(segments.size() == 2);
+    CHECK(segments[0].len == 4 && segments[1].len == 8);
+    // CS is released by the same ioctl
+    CHECK(segments[1].cs_change == 0);
+    CHECK(io.written.size() == 12 && io.written[0] == 0x03 && io.written[2] == 0x01);
+    CHECK(data[0] == 1 && data[7] == 1);
+}
+
+static void test_complete() {
+    spidev_io_fake io;
+    spi::bus_spidev bus("/dev/spidev0.0", spi::spi_mode(), io);
+
+    uint8_t length = 0;
+    {
+        auto transaction = bus.transaction();
+        const uint8_t out = 0x41;
+        transaction.write_read(1, &out, &length);
+        CHECK(io.messages.empty());
+        transaction.complete();
+        CHECK(length == 0x42);
+        CHECK(io.messages.size() == 1);
+        // CS stays asserted until the transaction ends
+        CHECK(io.messages[0].segments.back().cs_change == 1);
+
+        CHECK(transaction.read_byte() == 1);
+        CHECK(io.messages.size() == 2);
+    }
+
+    // Nothing left to send, so an empty segment releases CS
+    CHECK(io.messages.size() == 3);
+    CHECK(io.messages[2].segments.size() == 1);
+    CHECK(io.messages[2].segments[0].len == 0 && io.messages[2].segments[0].cs_change == 0);
+}
+
+static void test_large_write() {
+    spidev_io_fake io;
+    spi::bus_spidev bus("/dev/spidev0.0", spi::spi_mode(), io);
+
+    uint8_t big[spi::bus_spidev::staging_size + 1] = {0};
+    big[0] = 0xAB;
+    bus.transaction().write_byte(0x02).write(sizeof(big), big).write_byte(0x04);
+
+    // The big write can't be copied, so it is sent before write() returns
+    CHECK(io.messages.size() == 2);
+    CHECK(io.messages[0].segments.size() == 2 && io.messages[0].segments[1].cs_change == 1);
+    CHECK(io.messages[1].segments.size() == 1 && io.messages[1].segments[0].cs_change == 0);
+    CHECK(io.written.size() == sizeof(big) + 2 && io.written[1] == 0xAB && io.written.back() == 0x04);
+}
+
+static void test_segment_limit() {
+    spidev_io_fake io;
+    spi::bus_spidev bus("/dev/spidev0.0", spi::spi_mode(), io);
+
+    {
+        auto transaction = bus.transaction();
+        for (uint8_t i = 0; i < spi::bus_spidev::max_segments + 1; i++) {
+            transaction.write_byte(i);
+        }
+    }
+    CHECK(io.messages.size() == 2);
+    CHECK(io.messages[0].segments.size() == spi::bus_spidev::max_segments);
+    CHECK(io.messages[1].segments.size() == 1);
+    CHECK(io.written.size() == spi::bus_spidev::max_segments + 1 && io.written.back() == spi::bus_spidev::max_segments);
+}
+
+int main() {
+    test_configure();
+    test_command_and_read_is_one_ioctl();
+    test_complete();
+    test_large_write();
+    test_segment_limit();
+    return spi_test::result("test_spidev");
+}